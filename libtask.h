@@ -0,0 +1,352 @@
+/*
+ * A work-stealing task runtime for user processes.
+ *
+ * A TaskPool runs small tasks on a fixed set of worker processes instead of spawning a
+ * process per task. Each worker has its own deque of tasks: it pushes and pops tasks at
+ * the bottom, and idle workers steal from the top of the others'. Tasks submitted from
+ * outside the pool go on a shared queue. Workers with nothing to do block on a
+ * semaphore and are woken by the next submission.
+ *
+ * Like libuser2.h this is all static inline, so there is nothing extra to link. The
+ * pool lives in memory the caller provides.
+ */
+
+#ifndef _LIBTASK_H
+#define _LIBTASK_H
+
+#include <string.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <libuser.h>
+#include "libuser2.h"
+
+#define TASK_MAXWORKERS     8
+#define TASK_DEQUE_SIZE     256     // tasks a worker holds before spawning runs them inline
+#define TASK_QUEUE_SIZE     1024    // tasks submitted from outside the pool and not yet taken
+
+typedef struct TaskWorker TaskWorker;
+typedef struct TaskPool TaskPool;
+
+// a task; Task_Spawn from within it adds to the worker's own deque
+typedef void (*TaskFunc)(TaskWorker *worker, void *arg);
+
+typedef struct Task {
+    TaskFunc func;
+    void *arg;
+} Task;
+
+/*
+ * Chase-Lev deque. Only the owner touches bottom; thieves race each other and the
+ * owner for the last task with a compare-and-swap on top.
+ */
+typedef struct TaskDeque {
+    int top;
+    int bottom;
+    Task tasks[TASK_DEQUE_SIZE];
+} TaskDeque;
+
+struct TaskWorker {
+    TaskPool *pool;
+    int index;
+    int pid;
+    unsigned int seed;      // for picking whom to steal from
+    int steals;             // tasks this worker stole
+    TaskDeque deque;
+};
+
+struct TaskPool {
+    int workers;
+    TaskWorker worker[TASK_MAXWORKERS];
+    USem queueLock;         // guards queue
+    Task queue[TASK_QUEUE_SIZE];
+    int queueHead;
+    int queueCount;
+    int pending;            // tasks submitted or spawned and not finished
+    int sleepers;           // workers that have said they will block on idleSid
+    int idleSid;
+    int doneSid;            // V'd whenever pending drops to 0
+    int stop;
+};
+
+static inline int
+TaskDeque_Push(TaskDeque *d, Task task)
+{
+    int b = __atomic_load_n(&d->bottom, __ATOMIC_SEQ_CST);
+    int t = __atomic_load_n(&d->top, __ATOMIC_SEQ_CST);
+    if (b - t >= TASK_DEQUE_SIZE) {
+        return FALSE;
+    }
+    d->tasks[b % TASK_DEQUE_SIZE] = task;
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_SEQ_CST);
+    return TRUE;
+}
+
+static inline int
+TaskDeque_Pop(TaskDeque *d, Task *task)
+{
+    int b = __atomic_load_n(&d->bottom, __ATOMIC_SEQ_CST) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_SEQ_CST);
+    int t = __atomic_load_n(&d->top, __ATOMIC_SEQ_CST);
+    if (t > b) {
+        // empty
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_SEQ_CST);
+        return FALSE;
+    }
+    *task = d->tasks[b % TASK_DEQUE_SIZE];
+    if (t == b) {
+        // the last one, which a thief may be taking too
+        int won = __atomic_compare_exchange_n(&d->top, &t, t + 1, FALSE,
+                                              __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_SEQ_CST);
+        return won;
+    }
+    return TRUE;
+}
+
+static inline int
+TaskDeque_Steal(TaskDeque *d, Task *task)
+{
+    int t = __atomic_load_n(&d->top, __ATOMIC_SEQ_CST);
+    int b = __atomic_load_n(&d->bottom, __ATOMIC_SEQ_CST);
+    if (t >= b) {
+        return FALSE;
+    }
+    *task = d->tasks[t % TASK_DEQUE_SIZE];
+    return __atomic_compare_exchange_n(&d->top, &t, t + 1, FALSE,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+// wakes one blocked worker, if any
+static inline void
+TaskPool_WakeOne(TaskPool *pool)
+{
+    int sleepers = __atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST);
+    while (sleepers > 0) {
+        if (__atomic_compare_exchange_n(&pool->sleepers, &sleepers, sleepers - 1, FALSE,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            Sys_SemV(pool->idleSid);
+            return;
+        }
+    }
+}
+
+/*
+ * TaskPool_Submit
+ *
+ * Queues func(worker, arg) from outside the pool. Returns P2_WOULD_BLOCK if the queue
+ * is full.
+ */
+static inline int
+TaskPool_Submit(TaskPool *pool, TaskFunc func, void *arg)
+{
+    USem_P(&pool->queueLock);
+    if (pool->queueCount == TASK_QUEUE_SIZE) {
+        USem_V(&pool->queueLock);
+        return P2_WOULD_BLOCK;
+    }
+    Task *task = &pool->queue[(pool->queueHead + pool->queueCount) % TASK_QUEUE_SIZE];
+    task->func = func;
+    task->arg = arg;
+    pool->queueCount++;
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    USem_V(&pool->queueLock);
+    TaskPool_WakeOne(pool);
+    return P1_SUCCESS;
+}
+
+/*
+ * Task_Spawn
+ *
+ * Adds func(worker, arg) to the calling worker's deque, where idle workers can steal
+ * it. Runs it at once if the deque is full.
+ */
+static inline void
+Task_Spawn(TaskWorker *worker, TaskFunc func, void *arg)
+{
+    Task task = {func, arg};
+    TaskPool *pool = worker->pool;
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    if (!TaskDeque_Push(&worker->deque, task)) {
+        func(worker, arg);
+        if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+            Sys_SemV(pool->doneSid);
+        }
+        return;
+    }
+    TaskPool_WakeOne(pool);
+}
+
+// finds a task: our own deque first, then the shared queue, then the others' deques
+static inline int
+TaskWorker_Find(TaskWorker *worker, Task *task)
+{
+    TaskPool *pool = worker->pool;
+    if (TaskDeque_Pop(&worker->deque, task)) {
+        return TRUE;
+    }
+    if (__atomic_load_n(&pool->queueCount, __ATOMIC_SEQ_CST) > 0) {
+        USem_P(&pool->queueLock);
+        int found = pool->queueCount > 0;
+        if (found) {
+            *task = pool->queue[pool->queueHead];
+            pool->queueHead = (pool->queueHead + 1) % TASK_QUEUE_SIZE;
+            pool->queueCount--;
+        }
+        USem_V(&pool->queueLock);
+        if (found) {
+            return TRUE;
+        }
+    }
+    // start at a random victim so thieves spread out
+    worker->seed = worker->seed * 1103515245 + 12345;
+    int start = (worker->seed >> 16) % pool->workers;
+    for (int i = 0; i < pool->workers; i++) {
+        int victim = (start + i) % pool->workers;
+        if (victim != worker->index && TaskDeque_Steal(&pool->worker[victim].deque, task)) {
+            worker->steals++;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * TaskWorker_Main
+ *
+ * Body of each worker process.
+ */
+static inline int
+TaskWorker_Main(void *arg)
+{
+    TaskWorker *worker = arg;
+    TaskPool *pool = worker->pool;
+    Task task;
+    for (;;) {
+        if (TaskWorker_Find(worker, &task)) {
+            task.func(worker, task.arg);
+            if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+                Sys_SemV(pool->doneSid);
+            }
+            continue;
+        }
+        if (__atomic_load_n(&pool->stop, __ATOMIC_SEQ_CST)) {
+            break;
+        }
+        // say we're going to sleep before looking one last time, so a submission
+        // after the look has a sleeper to wake
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (TaskWorker_Find(worker, &task)) {
+            int sleepers = __atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST);
+            int undone = FALSE;
+            while (sleepers > 0 && !undone) {
+                undone = __atomic_compare_exchange_n(&pool->sleepers, &sleepers, sleepers - 1,
+                                                     FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+            }
+            if (!undone) {
+                // somebody already took us off, so take the V they sent
+                Sys_SemP(pool->idleSid);
+            }
+            task.func(worker, task.arg);
+            if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+                Sys_SemV(pool->doneSid);
+            }
+            continue;
+        }
+        Sys_SemP(pool->idleSid);
+    }
+    return worker->steals;
+}
+
+static inline int TaskPool_Stop(TaskPool *pool);
+
+/*
+ * TaskPool_Start
+ *
+ * Starts workers worker processes at the given priority. name distinguishes the
+ * pool's semaphores and processes from those of other pools. Returns P2_INVALID_SIZE
+ * if workers is out of range. If a semaphore or worker can't be created, whatever was
+ * already created is freed or stopped again before the error is returned.
+ */
+static inline int
+TaskPool_Start(TaskPool *pool, char *name, int workers, int priority)
+{
+    char buf[P1_MAXNAME+1];
+    int rc;
+    int freed;
+    if (workers <= 0 || workers > TASK_MAXWORKERS) {
+        return P2_INVALID_SIZE;
+    }
+    memset(pool, 0, sizeof(*pool));
+    pool->workers = workers;
+    USem_Init(&pool->queueLock, 1);
+    snprintf(buf, sizeof(buf), "%s_Idle", name);
+    rc = Sys_SemCreate(buf, 0, &pool->idleSid);
+    if (rc != P1_SUCCESS) {
+        return rc;
+    }
+    snprintf(buf, sizeof(buf), "%s_Done", name);
+    rc = Sys_SemCreate(buf, 0, &pool->doneSid);
+    if (rc != P1_SUCCESS) {
+        freed = Sys_SemFree(pool->idleSid);
+        return rc;
+    }
+    for (int i = 0; i < workers; i++) {
+        TaskWorker *worker = &pool->worker[i];
+        worker->pool = pool;
+        worker->index = i;
+        worker->seed = i + 1;
+        snprintf(buf, sizeof(buf), "%s_Worker%d", name, i);
+        rc = Sys_Spawn(buf, TaskWorker_Main, worker, 2*USLOSS_MIN_STACK, priority, &worker->pid);
+        if (rc != P1_SUCCESS) {
+            // stops and reaps the ones already running, and frees the semaphores
+            pool->workers = i;
+            TaskPool_Stop(pool);
+            return rc;
+        }
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * TaskPool_Wait
+ *
+ * Blocks until every task submitted or spawned so far has finished.
+ */
+static inline void
+TaskPool_Wait(TaskPool *pool)
+{
+    // V's from earlier times pending hit 0 just send us round again
+    while (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) > 0) {
+        Sys_SemP(pool->doneSid);
+    }
+}
+
+/*
+ * TaskPool_Stop
+ *
+ * Waits for the tasks to finish, stops the workers and reaps them. Returns how many
+ * tasks were stolen in all.
+ */
+static inline int
+TaskPool_Stop(TaskPool *pool)
+{
+    int rc;
+    int status;
+    int steals = 0;
+    TaskPool_Wait(pool);
+    __atomic_store_n(&pool->stop, TRUE, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < pool->workers; i++) {
+        Sys_SemV(pool->idleSid);
+    }
+    for (int i = 0; i < pool->workers; i++) {
+        rc = Sys_WaitPid(pool->worker[i].pid, &status);
+        if (rc == P1_SUCCESS) {
+            steals += status;
+        }
+    }
+    rc = Sys_SemFree(pool->idleSid);
+    rc = Sys_SemFree(pool->doneSid);
+    return steals;
+}
+
+#endif
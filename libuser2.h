@@ -0,0 +1,781 @@
+/*
+ * User-level interface to the Phase 2 extensions in phase2Ext.h, in the same style
+ * as libuser.h. Results come back in the USLOSS_Sysargs the same way they do for
+ * the libuser calls, with the return code in arg4.
+ */
+
+#ifndef _LIBUSER2_H
+#define _LIBUSER2_H
+
+#include <usloss.h>
+#include "phase2Ext.h"
+
+/*
+ * Sys_Batch
+ *
+ * Makes each of the n system calls in calls, in order, in a single trap. Each call's
+ * results are left in its own entry. With P2_BATCH_STOP in flags it stops after the
+ * first call that returns a negative value in arg4. *done is set to the number of calls
+ * that were made.
+ */
+static inline int
+Sys_Batch(USLOSS_Sysargs *calls, int n, int flags, int *done)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_BATCH;
+    sa.arg1 = (void *) calls;
+    sa.arg2 = (void *) n;
+    sa.arg3 = (void *) flags;
+    USLOSS_Syscall(&sa);
+    if (done != NULL) {
+        *done = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SyscallStats
+ *
+ * Returns the statistics for a system call number. They are all zero unless the kernel
+ * has turned them on with P2SyscallStatsEnable.
+ */
+static inline int
+Sys_SyscallStats(int number, P2_SyscallStats *stats)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_SYSCALLSTATS;
+    sa.arg1 = (void *) number;
+    sa.arg2 = (void *) stats;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SpawnN
+ *
+ * Spawns n processes in a single trap. Process i is named prefix followed by i, runs
+ * func(args[i]) (or func(NULL) if args is NULL), and its pid is stored in pids[i]. If
+ * a spawn fails no more are attempted; *spawned is set to the number that were. flags
+ * are as for Sys_SpawnEx.
+ */
+static inline int
+Sys_SpawnN(char *prefix, int (*func)(void *), void **args, int n, int stackSize,
+           int priority, int flags, int *pids, int *spawned)
+{
+    USLOSS_Sysargs sa;
+    P2_SpawnRequest req;
+    req.name = prefix;
+    req.func = func;
+    req.args = args;
+    req.n = n;
+    req.stackSize = stackSize;
+    req.priority = priority;
+    req.flags = flags;
+    req.pids = pids;
+    sa.number = SYS_SPAWNN;
+    sa.arg1 = (void *) &req;
+    USLOSS_Syscall(&sa);
+    if (spawned != NULL) {
+        *spawned = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SpawnEx
+ *
+ * Sys_Spawn with flags. With P2_SPAWN_DETACHED the process is reaped automatically
+ * when it quits, and can't be waited for.
+ */
+static inline int
+Sys_SpawnEx(char *name, int (*func)(void *), void *arg, int stackSize, int priority,
+            int flags, int *pid)
+{
+    USLOSS_Sysargs sa;
+    P2_SpawnRequest req;
+    req.name = name;
+    req.func = func;
+    req.args = &arg;
+    req.n = 1;
+    req.stackSize = stackSize;
+    req.priority = priority;
+    req.flags = flags;
+    req.pids = pid;
+    sa.number = SYS_SPAWNEX;
+    sa.arg1 = (void *) &req;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_ProcSnapshot
+ *
+ * Copies the entries of up to max live processes into buf in a single trap, and sets
+ * *count to how many there are. Their children are only copied if flags includes
+ * P2_SNAPSHOT_CHILDREN.
+ */
+static inline int
+Sys_ProcSnapshot(P2_ProcEntry *buf, int max, int flags, int *count)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_PROCSNAPSHOT;
+    sa.arg1 = (void *) buf;
+    sa.arg2 = (void *) max;
+    sa.arg3 = (void *) flags;
+    USLOSS_Syscall(&sa);
+    if (count != NULL) {
+        *count = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_ProcStats
+ *
+ * Returns the accounting counters of process pid.
+ */
+static inline int
+Sys_ProcStats(int pid, P2_ProcStats *stats)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_PROCSTATS;
+    sa.arg1 = (void *) pid;
+    sa.arg2 = (void *) stats;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_PoolSubmit
+ *
+ * Hands func(arg) to the worker pool and returns a ticket for it in *ticket. Blocks
+ * while the pool has as many tasks as it can hold.
+ */
+static inline int
+Sys_PoolSubmit(int (*func)(void *), void *arg, int *ticket)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_POOL;
+    sa.arg1 = (void *) func;
+    sa.arg2 = arg;
+    sa.arg5 = (void *) P2_POOL_SUBMIT;
+    USLOSS_Syscall(&sa);
+    if (ticket != NULL) {
+        *ticket = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_PoolJoin
+ *
+ * Waits for the task with the given ticket to finish and returns what it returned in
+ * *result. Each ticket can be joined once.
+ */
+static inline int
+Sys_PoolJoin(int ticket, int *result)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_POOL;
+    sa.arg1 = (void *) ticket;
+    sa.arg5 = (void *) P2_POOL_JOIN;
+    USLOSS_Syscall(&sa);
+    if (result != NULL) {
+        *result = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitPid
+ *
+ * Waits for the child pid to quit and returns its status.
+ */
+static inline int
+Sys_WaitPid(int pid, int *status)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_WAITEX;
+    sa.arg1 = (void *) pid;
+    sa.arg2 = (void *) -1;
+    USLOSS_Syscall(&sa);
+    if (status != NULL) {
+        *status = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitNoHang
+ *
+ * Like Sys_Wait, but returns P2_WOULD_BLOCK instead of waiting if no child has quit.
+ */
+static inline int
+Sys_WaitNoHang(int *pid, int *status)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_WAITEX;
+    sa.arg1 = (void *) -1;
+    sa.arg2 = (void *) 0;
+    USLOSS_Syscall(&sa);
+    if (pid != NULL) {
+        *pid = (int) sa.arg1;
+    }
+    if (status != NULL) {
+        *status = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitTimed
+ *
+ * Like Sys_Wait, but returns P2_TIMEOUT if no child has quit within timeout
+ * microseconds.
+ */
+static inline int
+Sys_WaitTimed(int timeout, int *pid, int *status)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_WAITEX;
+    sa.arg1 = (void *) -1;
+    sa.arg2 = (void *) timeout;
+    USLOSS_Syscall(&sa);
+    if (pid != NULL) {
+        *pid = (int) sa.arg1;
+    }
+    if (status != NULL) {
+        *status = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitMany
+ *
+ * Waits for each of the n children in pids and stores their statuses in statuses, in a
+ * single trap. Stops at the first wait that fails; *reaped is set to how many succeeded.
+ */
+static inline int
+Sys_WaitMany(int *pids, int *statuses, int n, int *reaped)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_WAITMANY;
+    sa.arg1 = (void *) pids;
+    sa.arg2 = (void *) statuses;
+    sa.arg3 = (void *) n;
+    USLOSS_Syscall(&sa);
+    if (reaped != NULL) {
+        *reaped = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_FutexWait
+ *
+ * Blocks until woken by Sys_FutexWake on addr, unless *addr != value.
+ */
+static inline int
+Sys_FutexWait(int *addr, int value)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_FUTEX;
+    sa.arg1 = (void *) addr;
+    sa.arg2 = (void *) value;
+    sa.arg5 = (void *) P2_FUTEX_WAIT;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_FutexWake
+ *
+ * Wakes up to n processes blocked in Sys_FutexWait on addr.
+ */
+static inline int
+Sys_FutexWake(int *addr, int n, int *woken)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_FUTEX;
+    sa.arg1 = (void *) addr;
+    sa.arg2 = (void *) n;
+    sa.arg5 = (void *) P2_FUTEX_WAKE;
+    USLOSS_Syscall(&sa);
+    if (woken != NULL) {
+        *woken = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SemOp
+ *
+ * Applies all of the n operations in ops atomically, blocking until it can.
+ */
+static inline int
+Sys_SemOp(P2_SemBuf *ops, int n)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_SEMOP;
+    sa.arg1 = (void *) ops;
+    sa.arg2 = (void *) n;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SemOpen
+ *
+ * Returns the semaphore called name in *sid, creating it with the given value if there
+ * is none. *created, if not NULL, says which.
+ */
+static inline int
+Sys_SemOpen(char *name, int value, int *sid, int *created)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_SEMOPEN;
+    sa.arg1 = (void *) value;
+    sa.arg2 = (void *) name;
+    USLOSS_Syscall(&sa);
+    if (sid != NULL) {
+        *sid = (int) sa.arg1;
+    }
+    if (created != NULL) {
+        *created = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_SemStats
+ *
+ * Returns the contention statistics of semaphore sid.
+ */
+static inline int
+Sys_SemStats(int sid, P2_SemStats *stats)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_SEMSTATS;
+    sa.arg1 = (void *) sid;
+    sa.arg2 = (void *) stats;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_DiskSubmit
+ *
+ * Starts the read or write described by io and returns a ticket for it in *ticket.
+ */
+static inline int
+Sys_DiskSubmit(P2_DiskIO *io, int *ticket)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_DISKASYNC;
+    sa.arg1 = (void *) io;
+    sa.arg5 = (void *) P2_DISK_SUBMIT;
+    USLOSS_Syscall(&sa);
+    if (ticket != NULL) {
+        *ticket = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_DiskPoll
+ *
+ * Returns the result of a submitted request in *result once it has completed.
+ */
+static inline int
+Sys_DiskPoll(int ticket, int *result)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_DISKASYNC;
+    sa.arg1 = (void *) ticket;
+    sa.arg5 = (void *) P2_DISK_POLL;
+    USLOSS_Syscall(&sa);
+    if (result != NULL) {
+        *result = (int) sa.arg2;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_WaitAny
+ *
+ * Blocks until one of the n objects is ready, and returns its index in *which.
+ */
+static inline int
+Sys_WaitAny(P2_WaitObj *objs, int n, int timeout, int *which)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_WAITANY;
+    sa.arg1 = (void *) objs;
+    sa.arg2 = (void *) n;
+    sa.arg3 = (void *) timeout;
+    USLOSS_Syscall(&sa);
+    if (which != NULL) {
+        *which = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MboxCreate
+ *
+ * Creates a mailbox of slots messages of up to slotSize bytes, and returns it in *mbox.
+ */
+static inline int
+Sys_MboxCreate(int slots, int slotSize, int *mbox)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_MBOXCREATE;
+    sa.arg1 = (void *) slots;
+    sa.arg2 = (void *) slotSize;
+    USLOSS_Syscall(&sa);
+    if (mbox != NULL) {
+        *mbox = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_MboxFree(int mbox)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_MBOXFREE;
+    sa.arg1 = (void *) mbox;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MboxSend
+ *
+ * Sends size bytes from msg. timeout is -1 to wait for room as long as it takes, 0
+ * not to wait, or a number of microseconds.
+ */
+static inline int
+Sys_MboxSend(int mbox, void *msg, int size, int timeout)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_MBOXSEND;
+    sa.arg1 = (void *) mbox;
+    sa.arg2 = msg;
+    sa.arg3 = (void *) size;
+    sa.arg5 = (void *) timeout;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MboxReceiveN
+ *
+ * Receives up to n messages into buf, which has room for n of the mailbox's slots, and
+ * returns how many in *got.
+ */
+static inline int
+Sys_MboxReceiveN(int mbox, void *buf, int n, int *sizes, int timeout, int *got)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_MBOXRECEIVE;
+    sa.arg1 = (void *) mbox;
+    sa.arg2 = buf;
+    sa.arg3 = (void *) n;
+    sa.arg4 = (void *) sizes;
+    sa.arg5 = (void *) timeout;
+    USLOSS_Syscall(&sa);
+    if (got != NULL) {
+        *got = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+/*
+ * Sys_MboxReceive
+ *
+ * Receives one message into buf, which has room for a slot, and returns its size.
+ */
+static inline int
+Sys_MboxReceive(int mbox, void *buf, int *size, int timeout)
+{
+    return Sys_MboxReceiveN(mbox, buf, 1, size, timeout, NULL);
+}
+
+/*
+ * Sys_MutexLock
+ *
+ * Blocks until the mutex at word is handed to the caller. UMutex_Lock calls it.
+ */
+static inline int
+Sys_MutexLock(int *word)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_MUTEX;
+    sa.arg1 = (void *) word;
+    sa.arg5 = (void *) P2_MUTEX_LOCK;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_MutexUnlock(int *word)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_MUTEX;
+    sa.arg1 = (void *) word;
+    sa.arg5 = (void *) P2_MUTEX_UNLOCK;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * UMutex
+ *
+ * A mutex that lives in user memory and knows its owner. Lock and unlock are a single
+ * atomic operation unless the mutex is held or has waiters. self is the caller's pid
+ * from Sys_GetPID, which the caller looks up once rather than on every call.
+ */
+typedef struct UMutex {
+    int word;       // see P2_MutexLock
+} UMutex;
+
+static inline void
+UMutex_Init(UMutex *m)
+{
+    m->word = 0;
+}
+
+static inline int
+UMutex_Lock(UMutex *m, int self)
+{
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&m->word, &expected, self + 1, FALSE,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return P1_SUCCESS;
+    }
+    return Sys_MutexLock(&m->word);
+}
+
+static inline int
+UMutex_Unlock(UMutex *m, int self)
+{
+    int expected = self + 1;
+    // fails if there are waiters, and the kernel hands it over
+    if (__atomic_compare_exchange_n(&m->word, &expected, 0, FALSE,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return P1_SUCCESS;
+    }
+    return Sys_MutexUnlock(&m->word);
+}
+
+// the owner's pid, or -1 if the mutex is free
+static inline int
+UMutex_Owner(UMutex *m)
+{
+    return (__atomic_load_n(&m->word, __ATOMIC_SEQ_CST) & ~P2_MUTEX_WAITERS) - 1;
+}
+
+/*
+ * Reader-writer locks
+ *
+ * Sys_RwCreate returns a new lock in *rw. Sys_RwRead and Sys_RwWrite block until the
+ * caller holds it for reading or writing, and Sys_RwUnlock releases either.
+ */
+static inline int
+Sys_RwOp(int op, int rw)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_RWLOCK;
+    sa.arg1 = (void *) rw;
+    sa.arg5 = (void *) op;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_RwCreate(int *rw)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_RWLOCK;
+    sa.arg5 = (void *) P2_RW_CREATE;
+    USLOSS_Syscall(&sa);
+    if (rw != NULL) {
+        *rw = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_RwRead(int rw)
+{
+    return Sys_RwOp(P2_RW_READ, rw);
+}
+
+static inline int
+Sys_RwWrite(int rw)
+{
+    return Sys_RwOp(P2_RW_WRITE, rw);
+}
+
+static inline int
+Sys_RwUnlock(int rw)
+{
+    return Sys_RwOp(P2_RW_UNLOCK, rw);
+}
+
+static inline int
+Sys_RwFree(int rw)
+{
+    return Sys_RwOp(P2_RW_FREE, rw);
+}
+
+/*
+ * Barriers
+ *
+ * Sys_BarrierCreate returns a barrier for n processes in *barrier. Sys_BarrierWait
+ * blocks until all n have called it.
+ */
+static inline int
+Sys_BarrierCreate(int n, int *barrier)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_BARRIER;
+    sa.arg1 = (void *) n;
+    sa.arg5 = (void *) P2_BARRIER_CREATE;
+    USLOSS_Syscall(&sa);
+    if (barrier != NULL) {
+        *barrier = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_BarrierWait(int barrier)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_BARRIER;
+    sa.arg1 = (void *) barrier;
+    sa.arg5 = (void *) P2_BARRIER_WAIT;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_BarrierFree(int barrier)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_BARRIER;
+    sa.arg1 = (void *) barrier;
+    sa.arg5 = (void *) P2_BARRIER_FREE;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+/*
+ * Condition variables
+ *
+ * Sys_CondWait releases the semaphore sid, waits to be signalled and takes sid again.
+ */
+static inline int
+Sys_CondOp(int op, int cv, int sid)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_COND;
+    sa.arg1 = (void *) cv;
+    sa.arg2 = (void *) sid;
+    sa.arg5 = (void *) op;
+    USLOSS_Syscall(&sa);
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_CondCreate(int *cv)
+{
+    USLOSS_Sysargs sa;
+    sa.number = SYS_COND;
+    sa.arg5 = (void *) P2_COND_CREATE;
+    USLOSS_Syscall(&sa);
+    if (cv != NULL) {
+        *cv = (int) sa.arg1;
+    }
+    return (int) sa.arg4;
+}
+
+static inline int
+Sys_CondWait(int cv, int sid)
+{
+    return Sys_CondOp(P2_COND_WAIT, cv, sid);
+}
+
+static inline int
+Sys_CondSignal(int cv)
+{
+    return Sys_CondOp(P2_COND_SIGNAL, cv, -1);
+}
+
+static inline int
+Sys_CondBroadcast(int cv)
+{
+    return Sys_CondOp(P2_COND_BROADCAST, cv, -1);
+}
+
+static inline int
+Sys_CondFree(int cv)
+{
+    return Sys_CondOp(P2_COND_FREE, cv, -1);
+}
+
+/*
+ * USem
+ *
+ * A counting semaphore that lives in user memory. P and V only trap when P has to
+ * block or V has someone to wake; otherwise they are a couple of atomic operations.
+ */
+typedef struct USem {
+    int value;
+    int waiters;    // processes in, or about to be in, Sys_FutexWait
+} USem;
+
+static inline void
+USem_Init(USem *sem, int value)
+{
+    sem->value = value;
+    sem->waiters = 0;
+}
+
+static inline int
+USem_P(USem *sem)
+{
+    int rc;
+    for (;;) {
+        int value = __atomic_load_n(&sem->value, __ATOMIC_SEQ_CST);
+        if (value > 0) {
+            if (__atomic_compare_exchange_n(&sem->value, &value, value - 1, FALSE,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                return P1_SUCCESS;
+            }
+            continue;
+        }
+        // a V after this point either sees us waiting or changes value first
+        __atomic_add_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+        rc = Sys_FutexWait(&sem->value, 0);
+        __atomic_sub_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+        if (rc != P1_SUCCESS && rc != P2_WOULD_BLOCK) {
+            return rc;
+        }
+    }
+}
+
+static inline int
+USem_V(USem *sem)
+{
+    __atomic_add_fetch(&sem->value, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sem->waiters, __ATOMIC_SEQ_CST) > 0) {
+        return Sys_FutexWake(&sem->value, 1, NULL);
+    }
+    return P1_SUCCESS;
+}
+
+#endif
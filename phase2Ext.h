@@ -0,0 +1,507 @@
+/*
+ * Extensions to the Phase 2 interface.
+ *
+ * phase2.h and phase2Int.h are fixed by the assignment, so everything we add
+ * on top of them is declared here. Include this after phase2Int.h. The user-level
+ * side of the new system calls is in libuser2.h.
+ */
+
+#ifndef _PHASE2_EXT_H
+#define _PHASE2_EXT_H
+
+#include <usloss.h>
+#include <phase1.h>
+#include "phase2.h"
+
+/*
+ * System call numbers for the extensions. They are handed out downwards from
+ * USLOSS_MAX_SYSCALLS so that they stay clear of the ones in usyscall.h.
+ */
+
+#define SYS_BATCH           (USLOSS_MAX_SYSCALLS - 0)
+#define SYS_SYSCALLSTATS    (USLOSS_MAX_SYSCALLS - 1)
+#define SYS_SPAWNN          (USLOSS_MAX_SYSCALLS - 2)
+#define SYS_POOL            (USLOSS_MAX_SYSCALLS - 3)
+#define SYS_WAITEX          (USLOSS_MAX_SYSCALLS - 4)
+#define SYS_WAITMANY        (USLOSS_MAX_SYSCALLS - 5)
+#define SYS_SPAWNEX         (USLOSS_MAX_SYSCALLS - 6)
+#define SYS_PROCSNAPSHOT    (USLOSS_MAX_SYSCALLS - 7)
+#define SYS_PROCSTATS       (USLOSS_MAX_SYSCALLS - 8)
+#define SYS_FUTEX           (USLOSS_MAX_SYSCALLS - 9)
+#define SYS_SEMOP           (USLOSS_MAX_SYSCALLS - 10)
+#define SYS_DISKASYNC       (USLOSS_MAX_SYSCALLS - 11)
+#define SYS_WAITANY         (USLOSS_MAX_SYSCALLS - 12)
+#define SYS_MBOXCREATE      (USLOSS_MAX_SYSCALLS - 13)
+#define SYS_MBOXFREE        (USLOSS_MAX_SYSCALLS - 14)
+#define SYS_MBOXSEND        (USLOSS_MAX_SYSCALLS - 15)
+#define SYS_MBOXRECEIVE     (USLOSS_MAX_SYSCALLS - 16)
+#define SYS_MUTEX           (USLOSS_MAX_SYSCALLS - 17)
+#define SYS_RWLOCK          (USLOSS_MAX_SYSCALLS - 18)
+#define SYS_BARRIER         (USLOSS_MAX_SYSCALLS - 19)
+#define SYS_COND            (USLOSS_MAX_SYSCALLS - 20)
+#define SYS_SEMSTATS        (USLOSS_MAX_SYSCALLS - 21)
+#define SYS_SEMOPEN         (USLOSS_MAX_SYSCALLS - 22)
+
+/*
+ * Error codes for the extensions, continuing on from the ones in phase2.h.
+ */
+#define P2_INVALID_TICKET       -26
+#define P2_TIMEOUT              -27
+#define P2_WOULD_BLOCK          -28
+#define P2_INVALID_FLAGS        -29
+#define P2_INVALID_MBOX         -30
+#define P2_INVALID_SIZE         -31
+#define P2_TOO_MANY_MBOXES      -32
+#define P2_NOT_OWNER            -33
+#define P2_INVALID_RWLOCK       -34
+#define P2_TOO_MANY_RWLOCKS     -35
+#define P2_INVALID_BARRIER      -36
+#define P2_TOO_MANY_BARRIERS    -37
+#define P2_INVALID_COND         -38
+#define P2_TOO_MANY_CONDS       -39
+#define P2_DEVICE_ERROR         -40
+#define P2_INVALID_TIMEOUT      -41
+
+// Phase 2a
+
+/*
+ * Flags for Sys_Batch.
+ *
+ * P2_BATCH_STOP: stop at the first call that returns a negative value in arg4.
+ * Sys_GetPID, Sys_GetTimeOfDay and Sys_Terminate return no status, so they
+ * never stop the batch.
+ */
+#define P2_BATCH_STOP       0x1
+
+/*
+ * Per-system call statistics, kept while enabled by P2SyscallStatsEnable.
+ * Only calls that return are counted. hist[0] counts calls that took less
+ * than 1us, hist[i] those that took [2^(i-1), 2^i) us, and the last bucket
+ * everything longer.
+ */
+#define P2_HIST_BUCKETS     24
+
+typedef struct P2_SyscallStats {
+    int count;
+    int total;      // microseconds
+    int max;        // microseconds
+    int hist[P2_HIST_BUCKETS];
+} P2_SyscallStats;
+
+extern  void    P2SyscallStatsEnable(int enable);
+extern  void    P2SyscallStatsDump(void);
+
+/*
+ * Flags for P2_SpawnEx.
+ *
+ * P2_SPAWN_DETACHED: nobody waits for the process. It is started as a child of a
+ * kernel reaper process, which reaps it as soon as it quits, so it doesn't show up
+ * in the caller's waits or hold on to its process table slot. P2ProcShutdown stops
+ * the reaper once the detached processes still running have quit.
+ */
+#define P2_SPAWN_DETACHED   0x1
+
+/*
+ * Arguments to Sys_SpawnN and Sys_SpawnEx, which have more than fit in a
+ * USLOSS_Sysargs. For Sys_SpawnN process i is named name followed by i and runs
+ * func(args[i]), or func(NULL) if args is NULL. Its pid is stored in pids[i].
+ * Sys_SpawnEx spawns one process with exactly this name.
+ */
+typedef struct P2_SpawnRequest {
+    char *name;
+    int (*func)(void *);
+    void **args;
+    int n;
+    int stackSize;
+    int priority;
+    int flags;
+    int *pids;
+} P2_SpawnRequest;
+
+extern  int     P2_SpawnEx(char *name, int (*func)(void *), void *arg, int stackSize,
+                           int priority, int flags, int *pid) CHECKRETURN;
+extern  int     P2_SpawnN(char *prefix, int (*func)(void *), void **args, int n, int stackSize,
+                          int priority, int flags, int *pids, int *spawned) CHECKRETURN;
+extern  void    P2ProcShutdown(void);
+
+/*
+ * Variants of P2_Wait. P2_WaitEx waits for the child pid, or any child if pid is -1.
+ * A timeout of -1 waits as long as it takes, 0 returns P2_WOULD_BLOCK at once if no
+ * such child has quit, a positive one is the number of microseconds to wait before
+ * returning P2_TIMEOUT, and any other fails with P2_INVALID_TIMEOUT. Timeouts are
+ * driven by the clock driver, so they need P2ClockInit. P2_WaitMany waits for each of
+ * the n children in pids in turn, stores their statuses in statuses, and returns how
+ * many it reaped in *reaped.
+ */
+extern  int     P2_WaitEx(int pid, int timeout, int *childPid, int *status) CHECKRETURN;
+extern  int     P2_WaitMany(int *pids, int *statuses, int n, int *reaped) CHECKRETURN;
+extern  void    P2ProcTick(int now);
+
+/*
+ * Blocking a process until something it is waiting for happens. P2ProcPark blocks
+ * the caller until P2ProcUnpark is called for it, or until the clock passes deadline
+ * (never if it is -1), when it returns P2_TIMEOUT. A wakeup that comes first isn't
+ * lost. Wakeups can be stale, so check again after every return. A child quitting
+ * unparks its parent. Every process blocked in phase2d, whatever it is waiting for,
+ * is parked this way, so timeouts and stray wakeups are handled in one place.
+ */
+extern  int     P2ProcPark(int deadline);
+extern  void    P2ProcUnpark(int pid);
+
+/*
+ * Process table snapshots. P2_ProcSnapshot copies the pid and P1_ProcInfo of every
+ * process that isn't free into buf, up to max of them, all taken at the same moment.
+ * *count is set to the number of such processes, which may be more than max. The
+ * children arrays are only copied with P2_SNAPSHOT_CHILDREN; numChildren always is.
+ */
+#define P2_SNAPSHOT_CHILDREN    0x1
+
+typedef struct P2_ProcEntry {
+    int pid;
+    P1_ProcInfo info;
+} P2_ProcEntry;
+
+extern  int     P2_ProcSnapshot(P2_ProcEntry *buf, int max, int flags, int *count) CHECKRETURN;
+
+/*
+ * Per-process accounting. Each process's counters are cleared when a user process
+ * starts in its slot. syscalls[i] counts the calls it made to system call i+1, and
+ * the times are in microseconds. P2ProcStatsFor returns the counters of a pid for the
+ * other layers to update.
+ */
+typedef struct P2_ProcStats {
+    int syscalls[USLOSS_MAX_SYSCALLS];
+    int sleepTime;          // in P2_Sleep
+    int sectorsRead;
+    int sectorsWritten;
+    int diskWait;           // waiting for disk requests to complete
+    int semWait;            // blocked in P on user semaphores
+} P2_ProcStats;
+
+extern  int             P2_ProcStatsGet(int pid, P2_ProcStats *stats) CHECKRETURN;
+extern  P2_ProcStats    *P2ProcStatsFor(int pid);
+
+/*
+ * Event tracing. While enabled by P2TraceEnable, the P2_TRACE points in every layer
+ * record events in a ring of the last P2_TRACE_EVENTS, each with the time, the pid
+ * that was running, and one argument. phase is 'B' or 'E' for the beginning and end
+ * of something that takes time, or 'i' for an instant. P2TraceDump prints the ring
+ * in Chrome's trace event JSON format, one thread per pid, or nothing if tracing was
+ * never enabled. P2TraceCount returns how many events in the ring have a given type
+ * and phase.
+ */
+#define P2_TRACE_EVENTS     4096
+
+#define P2_TRACE_SYSCALL    0   // arg is the system call number
+#define P2_TRACE_SPAWN      1   // arg is the new pid
+#define P2_TRACE_TERMINATE  2   // arg is the status
+#define P2_TRACE_WAIT       3   // arg is the pid waited for, or -1
+#define P2_TRACE_SLEEP      4   // arg is the number of seconds
+#define P2_TRACE_WAKE       5   // arg is the pid woken
+#define P2_TRACE_DISK_QUEUE 6   // arg is the track
+#define P2_TRACE_DISK_SEEK  7   // arg is the track
+#define P2_TRACE_DISK_XFER  8   // arg is the sector
+#define P2_TRACE_DISK_DONE  9   // arg is the result
+#define P2_TRACE_SEM_P      10  // arg is the sid
+#define P2_TRACE_SEM_V      11  // arg is the sid
+#define P2_TRACE_TYPES      12
+
+extern  int     p2TraceEnabled;
+
+#define P2_TRACE(type, phase, arg) do { \
+    if (p2TraceEnabled) { \
+        P2Trace((type), (phase), (arg)); \
+    } \
+} while (0)
+
+extern  void    P2Trace(int type, char phase, int arg);
+extern  void    P2TraceEnable(int enable);
+extern  int     P2TraceCount(int type, char phase);
+extern  void    P2TraceDump(void);
+
+/*
+ * The worker pool. P2PoolInit starts a pool of user processes that run functions
+ * handed to them with P2_PoolSubmit; P2_PoolJoin waits for one to finish and returns
+ * what it returned. Without P2PoolInit, the first P2_PoolSubmit starts a small pool,
+ * so nothing runs until the pool is used. SYS_POOL carries the operation in arg5:
+ * P2_POOL_SUBMIT and P2_POOL_JOIN for the calls in libuser2.h, and P2_POOL_NEXT, which
+ * only the pool's own processes may use to hand back a result and get their next task;
+ * anyone else gets P2_INVALID_SYSCALL.
+ */
+#define P2_POOL_SUBMIT      0
+#define P2_POOL_JOIN        1
+#define P2_POOL_NEXT        2
+
+extern  int     P2PoolInit(int workers, int priority) CHECKRETURN;
+extern  void    P2PoolShutdown(void);
+extern  int     P2_PoolSubmit(int (*func)(void *), void *arg, int *ticket) CHECKRETURN;
+extern  int     P2_PoolJoin(int ticket, int *result) CHECKRETURN;
+
+extern  int     P2DisableInterrupts(void);
+extern  void    P2RestoreInterrupts(int enabled);
+
+// Phase 2c
+
+/*
+ * Options for P2DiskConfigure.
+ *
+ * P2_DISK_TRACKBUF: the driver reads each track it touches into a per-unit
+ * track buffer and serves requests from it. Writes are held in the buffer
+ * and written back a track at a time when the driver moves to another track
+ * or the disk is shut down.
+ *
+ * P2_DISK_LOG: the last eighth of the unit (at least one track) becomes a
+ * write log and is no longer available to users. Writes are appended to the
+ * log instead of going to their home locations, so scattered small writes
+ * become sequential. The driver moves logged sectors back home while it is
+ * idle, when the log fills up, and when the option is turned off or the disk
+ * is shut down. Turning it on fails with P1_INVALID_STATE if anything has
+ * been written to that part of the unit, since the log would overwrite it;
+ * turning it off clears the area again.
+ *
+ * P2_DISK_DIRECT: whole tracks of a request are transferred straight between
+ * the disk and the caller's buffer, without going through the track buffer
+ * or the log, unless part of a track being read is only held there.
+ */
+#define P2_DISK_TRACKBUF    0x1
+#define P2_DISK_LOG         0x2
+#define P2_DISK_DIRECT      0x4
+
+typedef struct P2_DiskStats {
+    int requests;       // reads and writes serviced
+    int directTracks;   // tracks transferred by P2_DISK_DIRECT
+} P2_DiskStats;
+
+extern  int     P2DiskConfigure(int unit, int flags) CHECKRETURN;
+extern  int     P2DiskDrain(int timeout, int *elapsed) CHECKRETURN;
+extern  int     P2DiskStats(int unit, P2_DiskStats *stats) CHECKRETURN;
+
+/*
+ * For testing how errors are handled: after P2DiskFailAfter(unit, n) the unit's next n
+ * sector reads and writes go ahead and the one after that fails with P2_DEVICE_ERROR,
+ * once. A negative n turns it off.
+ */
+extern  int     P2DiskFailAfter(int unit, int transfers) CHECKRETURN;
+
+/*
+ * Reads and writes that don't block. P2_DiskSubmit queues the request and returns a
+ * ticket for it, or P2_WOULD_BLOCK if too many submitted requests haven't been polled
+ * yet. P2_DiskPoll returns P2_WOULD_BLOCK until the request has completed, then puts
+ * its result in *result and forgets the ticket; only the submitter can poll it. The
+ * buffer must stay valid until then, so poll every request before quitting. Finishing
+ * a request unparks its submitter (see P2ProcPark). SYS_DISKASYNC carries the
+ * operation in arg5.
+ */
+#define P2_DISK_SUBMIT      0
+#define P2_DISK_POLL        1
+
+typedef struct P2_DiskIO {
+    int write;      // TRUE to write, FALSE to read
+    int unit;
+    int track;
+    int first;
+    int sectors;
+    void *buffer;
+} P2_DiskIO;
+
+extern  int     P2_DiskSubmit(P2_DiskIO *io, int *ticket) CHECKRETURN;
+extern  int     P2_DiskPoll(int ticket, int *result) CHECKRETURN;
+
+// Phase 2d
+
+/*
+ * Waiting on a word of user memory, for semaphores that only trap when they have to
+ * block (see USem in libuser2.h). P2_FutexWait blocks the caller until P2_FutexWake
+ * is called for the same address, unless *addr no longer equals value, in which case
+ * it returns P2_WOULD_BLOCK at once. P2_FutexWake wakes up to n processes waiting on
+ * addr, oldest first, and returns how many it woke in *woken. SYS_FUTEX carries the
+ * operation in arg5.
+ */
+#define P2_FUTEX_WAIT       0
+#define P2_FUTEX_WAKE       1
+
+extern  int     P2_FutexWait(int *addr, int value) CHECKRETURN;
+extern  int     P2_FutexWake(int *addr, int n, int *woken) CHECKRETURN;
+
+/*
+ * Operations on several user semaphores at once. P2_SemOp adds each delta to its
+ * semaphore, all together or not at all: it blocks until it can do them all without
+ * any semaphore going negative. A delta of -1 is a P and +1 is a V. Processes blocked
+ * in P2_SemOp (and Sys_SemP, which is a P2_SemOp of one P) are served in the order
+ * they blocked, skipping those that still can't go ahead. Operations that can be done
+ * at once are, so a set of V's never blocks.
+ */
+#define P2_SEMOP_MAX        16
+
+typedef struct P2_SemBuf {
+    int sid;
+    int delta;
+} P2_SemBuf;
+
+extern  int     P2_SemOp(P2_SemBuf *ops, int n) CHECKRETURN;
+
+/*
+ * Contention statistics for each user semaphore, kept from when it is created. Every
+ * operation with a negative delta counts as a P. holder is the process that most often
+ * made the last successful P before a P blocked, which for a semaphore used as a lock
+ * is whoever was holding it. Only the P2_SEM_CONTENDERS processes blamed most are
+ * kept; one that displaces another takes over its count, so once more processes than
+ * that have been blamed the counts are upper bounds. P2SemStatsDump prints them for
+ * every semaphore that was used, the ones blocked on longest first.
+ */
+#define P2_SEM_CONTENDERS   4
+
+typedef struct P2_SemStats {
+    int p;          // P's
+    int blocked;    // P's that had to wait
+    int totalWait;  // microseconds spent blocked
+    int maxWait;
+    int maxQueue;   // most processes blocked at once
+    int holder;     // pid, or -1 if no P has blocked
+    int contenders[P2_SEM_CONTENDERS];  // pids blamed for blocks, or -1
+    int blames[P2_SEM_CONTENDERS];      // times each was blamed
+} P2_SemStats;
+
+extern  int     P2_SemStatsGet(int sid, P2_SemStats *stats) CHECKRETURN;
+extern  void    P2SemStatsDump(void);
+
+/*
+ * Opening a user semaphore by name. P2_SemOpen returns the user semaphore called name
+ * in *sid, creating it with the given value if there isn't one, and sets *created if
+ * it did. Names are hashed, so this doesn't depend on how many semaphores there are.
+ */
+extern  int     P2_SemOpen(char *name, int value, int *sid, int *created) CHECKRETURN;
+
+/*
+ * Waiting for whichever of several things happens first. P2_WaitAny blocks until one
+ * of the n objects is ready, takes it, and returns its index in *which. Objects are
+ * checked in order, so earlier ones win ties.
+ *
+ * P2_WAIT_SEM: id is a user semaphore, which is P'd.
+ * P2_WAIT_CHILD: id is a child's pid, or -1 for any child. The child is reaped, its
+ * pid is put in pid and its status in result.
+ * P2_WAIT_DISK: id is a ticket from P2_DiskSubmit, which is polled; the request's
+ * result is put in result.
+ *
+ * If checking an object fails (say the caller has no children) that error is returned,
+ * also with its index in *which. timeout is in microseconds; 0 returns P2_WOULD_BLOCK
+ * at once if nothing is ready, -1 waits as long as it takes, a positive one returns
+ * P2_TIMEOUT when it runs out, and any other fails with P2_INVALID_TIMEOUT, as for
+ * P2_WaitEx.
+ */
+#define P2_WAITANY_MAX      16
+
+#define P2_WAIT_SEM         0
+#define P2_WAIT_CHILD       1
+#define P2_WAIT_DISK        2
+
+typedef struct P2_WaitObj {
+    int type;       // P2_WAIT_*
+    int id;
+    int result;     // set when it is taken
+    int pid;        // set when a P2_WAIT_CHILD is taken
+} P2_WaitObj;
+
+extern  int     P2_WaitAny(P2_WaitObj *objs, int n, int timeout, int *which) CHECKRETURN;
+
+/*
+ * Bounded message queues. A mailbox holds up to slots messages of up to slotSize
+ * bytes each, in the order they were sent. P2_MboxSend blocks while the mailbox is
+ * full and P2_MboxReceive while it is empty; timeout works as for P2_WaitAny. A
+ * receive takes up to n messages at once, as many as there are, and puts message i
+ * at buf + i*slotSize and its size in sizes[i]. A message sent while a process is
+ * waiting to receive is copied straight into its buffer, and one sent while the
+ * mailbox is full goes straight to the next receiver once the mailbox has drained.
+ * A mailbox can't be freed while processes are blocked on it. Its slots take at most
+ * P2_MBOX_MAXBYTES in all; P2_MboxCreate returns P2_INVALID_SIZE for more.
+ */
+#define P2_MAXMBOX          64
+#define P2_MBOX_MAXBYTES    (64 * 1024)
+
+extern  int     P2_MboxCreate(int slots, int slotSize, int *mbox) CHECKRETURN;
+extern  int     P2_MboxFree(int mbox) CHECKRETURN;
+extern  int     P2_MboxSend(int mbox, void *msg, int size, int timeout) CHECKRETURN;
+extern  int     P2_MboxReceive(int mbox, void *buf, int n, int *sizes, int timeout,
+                               int *got) CHECKRETURN;
+
+/*
+ * Mutexes that live in a word of user memory (see UMutex in libuser2.h). The word is
+ * 0 when the mutex is free and otherwise holds its owner's pid + 1, with
+ * P2_MUTEX_WAITERS set while processes are blocked on it. Locking and unlocking only
+ * trap when the mutex is held or has waiters. P2_MutexLock blocks the caller until
+ * the mutex is handed to it, and returns P1_INVALID_STATE if the caller already holds
+ * it or the word doesn't hold a pid. P2_MutexUnlock hands it straight to the waiter
+ * with the highest priority, oldest first among equals. It returns P2_NOT_OWNER if the
+ * caller doesn't hold the mutex. A waiter lends its priority to the owner, and through
+ * it down a chain of owners blocked on other mutexes, until the owner unlocks. Phase 1
+ * can't change the priority a process is scheduled at, so this only moves a boosted
+ * owner up the queues of the mutexes it waits for. SYS_MUTEX carries the operation in
+ * arg5.
+ */
+#define P2_MUTEX_LOCK       0
+#define P2_MUTEX_UNLOCK     1
+
+#define P2_MUTEX_WAITERS    0x40000000
+
+extern  int     P2_MutexLock(int *word) CHECKRETURN;
+extern  int     P2_MutexUnlock(int *word) CHECKRETURN;
+
+/*
+ * Reader-writer locks. Any number of readers can hold one at once, or a single writer.
+ * Writers come first: once a writer is waiting, new readers wait behind it. When a
+ * writer unlocks, every reader waiting gets the lock together; if there are none, the
+ * next writer gets it. Waiters are handed the lock before they are woken, so nobody
+ * can take it in between. P2_RwUnlock returns P2_NOT_OWNER if the caller can't be
+ * holding the lock. SYS_RWLOCK carries the operation in arg5.
+ */
+#define P2_MAXRWLOCK        64
+
+#define P2_RW_CREATE        0
+#define P2_RW_READ          1
+#define P2_RW_WRITE         2
+#define P2_RW_UNLOCK        3
+#define P2_RW_FREE          4
+
+extern  int     P2_RwCreate(int *rw) CHECKRETURN;
+extern  int     P2_RwRead(int rw) CHECKRETURN;
+extern  int     P2_RwWrite(int rw) CHECKRETURN;
+extern  int     P2_RwUnlock(int rw) CHECKRETURN;
+extern  int     P2_RwFree(int rw) CHECKRETURN;
+
+/*
+ * Barriers. P2_BarrierWait blocks until n processes have called it, then lets them all
+ * go at once, and the barrier is ready for the next round. SYS_BARRIER carries the
+ * operation in arg5.
+ */
+#define P2_MAXBARRIER       64
+
+#define P2_BARRIER_CREATE   0
+#define P2_BARRIER_WAIT     1
+#define P2_BARRIER_FREE     2
+
+extern  int     P2_BarrierCreate(int n, int *barrier) CHECKRETURN;
+extern  int     P2_BarrierWait(int barrier) CHECKRETURN;
+extern  int     P2_BarrierFree(int barrier) CHECKRETURN;
+
+/*
+ * Condition variables, used with a user semaphore as the mutex. P2_CondWait V's sid
+ * and blocks on cv in one step, so a signal in between isn't missed, and P's sid again
+ * before it returns. P2_CondSignal wakes the oldest waiter and P2_CondBroadcast wakes
+ * them all. Signals with nobody waiting are lost. SYS_COND carries the operation in
+ * arg5.
+ */
+#define P2_MAXCOND          64
+
+#define P2_COND_CREATE      0
+#define P2_COND_WAIT        1
+#define P2_COND_SIGNAL      2
+#define P2_COND_BROADCAST   3
+#define P2_COND_FREE        4
+
+extern  int     P2_CondCreate(int *cv) CHECKRETURN;
+extern  int     P2_CondWait(int cv, int sid) CHECKRETURN;
+extern  int     P2_CondSignal(int cv) CHECKRETURN;
+extern  int     P2_CondBroadcast(int cv) CHECKRETURN;
+extern  int     P2_CondFree(int cv) CHECKRETURN;
+
+#endif
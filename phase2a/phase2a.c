@@ -3,11 +3,14 @@
 #include <phase1.h>
 #include <phase2.h>
 #include <stdio.h>
+#include <string.h>
+#include <stddef.h>
 #include <assert.h>
 #include <libuser.h>
 #include <usyscall.h>
 
 #include "phase2Int.h"
+#include "phase2Ext.h"
 
 #define TAG_KERNEL 0
 #define TAG_USER 1
@@ -18,8 +21,93 @@ static void TerminateStub(USLOSS_Sysargs *sysargs);
 static void WaitStub(USLOSS_Sysargs *sysargs);
 static void ProcInfoStub(USLOSS_Sysargs *sysargs);
 static void GetPidStub(USLOSS_Sysargs *sysargs);
+static void BatchStub(USLOSS_Sysargs *sysargs);
+static void SyscallStatsStub(USLOSS_Sysargs *sysargs);
+static void SpawnNStub(USLOSS_Sysargs *sysargs);
+static void PoolStub(USLOSS_Sysargs *sysargs);
+static void WaitExStub(USLOSS_Sysargs *sysargs);
+static void WaitManyStub(USLOSS_Sysargs *sysargs);
+static void SpawnExStub(USLOSS_Sysargs *sysargs);
+static void ProcSnapshotStub(USLOSS_Sysargs *sysargs);
+static void ProcStatsStub(USLOSS_Sysargs *sysargs);
+static void PoolStop(void);
+static int  WaitFor(int self, int pid, int timeout, int deadline, int *childPid, int *status);
+static int  SpawnDetached(char *name, int (*func)(void *), void *arg, int stackSize,
+                          int priority, int *pid);
 void (*syscallTable[USLOSS_MAX_SYSCALLS])(USLOSS_Sysargs *args);
 
+// children that have been reaped by P1_Join but not yet returned to their parent
+typedef struct Reaped {
+    int parent;     // -1 if the entry is free
+    int pid;
+    int status;
+} Reaped;
+
+#define MAX_REAPED (2 * P1_MAXPROC)
+
+static Reaped reaped[MAX_REAPED];
+
+// per-process state for waiting on children
+typedef struct Waiter {
+    int sid;            // V'd when a child terminates and when deadline passes
+    int deadline;       // -1 if not in a timed wait
+    int terminating;    // this process is in P2_Terminate
+} Waiter;
+
+static Waiter waiters[P1_MAXPROC];
+
+// the process that spawns and reaps detached processes, started by the first one
+typedef struct Reaper {
+    int pid;            // -1 if it isn't running
+    int mutex;          // one request at a time
+    int doneSid;        // V'd by the reaper when it has handled the request
+    int stop;
+    char *name;         // the spawn request
+    int (*func)(void *);
+    void *arg;
+    int stackSize;
+    int priority;
+    int rc;
+    int child;
+} Reaper;
+
+static Reaper reaper;
+
+static int poolMutex;       // serializes starting and stopping the worker pool
+
+static P2_ProcStats procStats[P1_MAXPROC];
+
+static int statsEnabled = FALSE;
+
+// one traced event
+typedef struct Event {
+    int time;
+    int pid;
+    int arg;
+    char type;
+    char phase;
+} Event;
+
+int p2TraceEnabled = FALSE;
+static int traceUsed = FALSE;
+static int traceCount;      // events recorded; the last P2_TRACE_EVENTS are in traceRing
+static Event traceRing[P2_TRACE_EVENTS];
+
+static char *traceNames[P2_TRACE_TYPES] = {
+    "syscall", "spawn", "terminate", "wait", "sleep", "wake",
+    "disk queue", "disk seek", "disk transfer", "disk done", "P", "V"
+};
+static P2_SyscallStats syscallStats[USLOSS_MAX_SYSCALLS];
+
+static int
+Now(void)
+{
+    int rc;
+    int now;
+    rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    return now;
+}
+
 /*
  * IllegalHandler
  *
@@ -42,6 +130,50 @@ IllegalHandler(int type, void *arg)
     }
 }
 
+/*
+ * Dispatch
+ *
+ * Calls the handler for a system call, or fails it with P2_INVALID_SYSCALL if there is none.
+ *
+ */
+
+static void
+Dispatch(USLOSS_Sysargs *sa)
+{
+    int number = sa->number;
+    int start;
+    int elapsed;
+    int bucket;
+    int enabled;
+    if (number <= 0 || number > USLOSS_MAX_SYSCALLS || syscallTable[number-1] == NULL) {
+        sa->arg4 = (void *) P2_INVALID_SYSCALL;
+        return;
+    }
+    // counted up front, since some calls don't return
+    procStats[P1_GetPid()].syscalls[number-1]++;
+    P2_TRACE(P2_TRACE_SYSCALL, 'B', number);
+    if (!statsEnabled) {
+        syscallTable[number-1](sa);
+        P2_TRACE(P2_TRACE_SYSCALL, 'E', number);
+        return;
+    }
+    start = Now();
+    syscallTable[number-1](sa);
+    elapsed = Now() - start;
+    P2_TRACE(P2_TRACE_SYSCALL, 'E', number);
+    for (bucket = 0; bucket < P2_HIST_BUCKETS - 1 && elapsed >= (1 << bucket); bucket++) {
+    }
+    enabled = P2DisableInterrupts();
+    P2_SyscallStats *stats = &syscallStats[number-1];
+    stats->count++;
+    stats->total += elapsed;
+    if (elapsed > stats->max) {
+        stats->max = elapsed;
+    }
+    stats->hist[bucket]++;
+    P2RestoreInterrupts(enabled);
+}
+
 /*
  * SyscallHandler
  *
@@ -54,7 +186,7 @@ SyscallHandler(int type, void *arg)
 {
     USLOSS_Sysargs* sa = (USLOSS_Sysargs*) arg;
     //USLOSS_Console("%d\n",sa->number);
-    syscallTable[sa->number-1](sa);
+    Dispatch(sa);
 }
 
 
@@ -86,6 +218,191 @@ P2ProcInit(void)
     assert(rc == P1_SUCCESS);
     rc = P2_SetSyscallHandler(SYS_GETPROCINFO, ProcInfoStub);
     assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_BATCH, BatchStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SYSCALLSTATS, SyscallStatsStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SPAWNN, SpawnNStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_POOL, PoolStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITEX, WaitExStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITMANY, WaitManyStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SPAWNEX, SpawnExStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_PROCSNAPSHOT, ProcSnapshotStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_PROCSTATS, ProcStatsStub);
+    assert(rc == P1_SUCCESS);
+
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        waiters[i].sid = -1;
+        waiters[i].deadline = -1;
+        waiters[i].terminating = FALSE;
+    }
+    for (int i = 0; i < MAX_REAPED; i++) {
+        reaped[i].parent = -1;
+    }
+    reaper.pid = -1;
+    rc = P1_SemCreate("Reaper_Mutex", 1, &reaper.mutex);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemCreate("Reaper_Done", 0, &reaper.doneSid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemCreate("Pool_Mutex", 1, &poolMutex);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * P2SyscallStatsEnable
+ *
+ * Turns the per-system call statistics on or off. Turning them on clears them.
+ *
+ */
+
+void
+P2SyscallStatsEnable(int enable)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (enable && !statsEnabled) {
+        memset(syscallStats, 0, sizeof(syscallStats));
+    }
+    statsEnabled = enable;
+}
+
+/*
+ * P2SyscallStatsDump
+ *
+ * Prints the statistics of every system call that has been made, if they were ever enabled.
+ *
+ */
+
+void
+P2SyscallStatsDump(void)
+{
+    int printed = FALSE;
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    for (int i = 0; i < USLOSS_MAX_SYSCALLS; i++) {
+        P2_SyscallStats *stats = &syscallStats[i];
+        if (stats->count == 0) {
+            continue;
+        }
+        if (!printed) {
+            USLOSS_Console("%7s %8s %10s %8s %8s  %s\n", "Syscall", "Count", "Total(us)", "Avg(us)",
+                           "Max(us)", "Histogram (<1us, <2us, <4us, ...)");
+            printed = TRUE;
+        }
+        USLOSS_Console("%7d %8d %10d %8d %8d  ", i+1, stats->count, stats->total,
+                       stats->total / stats->count, stats->max);
+        int last = P2_HIST_BUCKETS - 1;
+        while (stats->hist[last] == 0) {
+            last--;
+        }
+        for (int j = 0; j <= last; j++) {
+            USLOSS_Console("%d ", stats->hist[j]);
+        }
+        USLOSS_Console("\n");
+    }
+}
+
+/*
+ * P2TraceEnable
+ *
+ * Turns event tracing on or off. Turning it on the first time clears the ring.
+ *
+ */
+void
+P2TraceEnable(int enable)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (enable && !traceUsed) {
+        traceCount = 0;
+        traceUsed = TRUE;
+    }
+    p2TraceEnabled = enable;
+}
+
+/*
+ * P2Trace
+ *
+ * Records an event in the ring, overwriting the oldest one if it is full. Use the
+ * P2_TRACE macro, which skips the call when tracing is off.
+ *
+ */
+void
+P2Trace(int type, char phase, int arg)
+{
+    int now = Now();
+    int enabled = P2DisableInterrupts();
+    Event *event = &traceRing[traceCount % P2_TRACE_EVENTS];
+    traceCount++;
+    event->time = now;
+    event->pid = P1_GetPid();
+    event->arg = arg;
+    event->type = type;
+    event->phase = phase;
+    P2RestoreInterrupts(enabled);
+}
+
+/*
+ * P2TraceCount
+ *
+ * Returns how many of the events in the ring have the given type and phase.
+ *
+ */
+int
+P2TraceCount(int type, char phase)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int count = 0;
+    int enabled = P2DisableInterrupts();
+    int first = traceCount > P2_TRACE_EVENTS ? traceCount - P2_TRACE_EVENTS : 0;
+    for (int i = first; i < traceCount; i++) {
+        Event *event = &traceRing[i % P2_TRACE_EVENTS];
+        if (event->type == type && event->phase == phase) {
+            count++;
+        }
+    }
+    P2RestoreInterrupts(enabled);
+    return count;
+}
+
+/*
+ * P2TraceDump
+ *
+ * Prints the events in the ring, oldest first, as Chrome trace event JSON.
+ *
+ */
+void
+P2TraceDump(void)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (!traceUsed) {
+        return;
+    }
+    int enabled = P2DisableInterrupts();
+    int first = traceCount > P2_TRACE_EVENTS ? traceCount - P2_TRACE_EVENTS : 0;
+    USLOSS_Console("{\"traceEvents\":[\n");
+    for (int i = first; i < traceCount; i++) {
+        Event *event = &traceRing[i % P2_TRACE_EVENTS];
+        USLOSS_Console("{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%d,\"pid\":1,\"tid\":%d,"
+                       "\"s\":\"t\",\"args\":{\"arg\":%d}}%s\n", traceNames[(int) event->type],
+                       event->phase, event->time, event->pid, event->arg,
+                       i < traceCount - 1 ? "," : "");
+    }
+    USLOSS_Console("]}\n");
+    P2RestoreInterrupts(enabled);
 }
 
 /*
@@ -110,13 +427,58 @@ P2_SetSyscallHandler(unsigned int number, void (*handler)(USLOSS_Sysargs *args))
     return P1_SUCCESS;
 }
 
+/*
+ * P2DisableInterrupts
+ *
+ * Disables interrupts so that the caller cannot be preempted. Returns whether they
+ * were enabled, to be passed to P2RestoreInterrupts.
+ */
+int
+P2DisableInterrupts(void)
+{
+    int rc;
+    int enabled = (USLOSS_PsrGet() & USLOSS_PSR_CURRENT_INT) != 0;
+    rc = USLOSS_PsrSet(USLOSS_PsrGet() & ~USLOSS_PSR_CURRENT_INT);
+    assert(rc == USLOSS_ERR_OK);
+    return enabled;
+}
+
+/*
+ * P2RestoreInterrupts
+ *
+ * Re-enables interrupts if they were enabled before P2DisableInterrupts.
+ */
+void
+P2RestoreInterrupts(int enabled)
+{
+    int rc;
+    if (enabled) {
+        rc = USLOSS_PsrSet(USLOSS_PsrGet() | USLOSS_PSR_CURRENT_INT);
+        assert(rc == USLOSS_ERR_OK);
+    }
+}
+
+// carries a new process's entry point and argument from P2_Spawn to wrapper
+typedef struct Launch {
+    int inUse;
+    int (*func)(void *);
+    void *arg;
+} Launch;
+
+static Launch launches[P1_MAXPROC];
+
 // a wrapper function to do quit
-int (*currentFunc)(void*);
 int wrapper(void* arg){
     int rc;
     int status;
+    Launch *launch = (Launch *) arg;
+    int (*func)(void *) = launch->func;
+    void *funcArg = launch->arg;
+    launch->inUse = FALSE;
+    waiters[P1_GetPid()].terminating = FALSE;
+    memset(&procStats[P1_GetPid()], 0, sizeof(P2_ProcStats));
     rc=USLOSS_PsrSet(USLOSS_PsrGet()&~USLOSS_PSR_CURRENT_MODE);
-    status = currentFunc(arg);
+    status = func(funcArg);
     Sys_Terminate(status);
     return 0;
 }
@@ -129,108 +491,1265 @@ int wrapper(void* arg){
  */
 int 
 P2_Spawn(char *name, int(*func)(void *arg), void *arg, int stackSize, int priority, int *pid) 
+{
+    return P2_SpawnEx(name, func, arg, stackSize, priority, 0, pid);
+}
+
+/*
+ * P2_SpawnEx
+ *
+ * Spawn a user-level process, possibly detached.
+ *
+ */
+int
+P2_SpawnEx(char *name, int (*func)(void *), void *arg, int stackSize, int priority, int flags,
+           int *pid)
 {
     // check kernel mode
     if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
         USLOSS_IllegalInstruction();
     }
     int rc=P1_SUCCESS;
-    currentFunc = func;
-    rc = P1_Fork(name,wrapper,arg,stackSize,priority,TAG_USER,pid);
+    Launch *launch = NULL;
+    if (flags & ~P2_SPAWN_DETACHED) {
+        return P2_INVALID_FLAGS;
+    }
+    if ((flags & P2_SPAWN_DETACHED) && P1_GetPid() != reaper.pid) {
+        return SpawnDetached(name, func, arg, stackSize, priority, pid);
+    }
+    // the child may run before P1_Fork returns, so it gets its own descriptor
+    int enabled = P2DisableInterrupts();
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        if (!launches[i].inUse) {
+            launch = &launches[i];
+            launch->inUse = TRUE;
+            break;
+        }
+    }
+    P2RestoreInterrupts(enabled);
+    if (launch == NULL) {
+        return P1_TOO_MANY_PROCESSES;
+    }
+    launch->func = func;
+    launch->arg = arg;
+    rc = P1_Fork(name,wrapper,launch,stackSize,priority,TAG_USER,pid);
+    if (rc != P1_SUCCESS) {
+        launch->inUse = FALSE;
+    } else {
+        P2_TRACE(P2_TRACE_SPAWN, 'i', *pid);
+    }
 
     return rc;
 }
 
 /*
- * P2_Wait
+ * P2_SpawnN
  *
- * Wait for a user-level process.
+ * Spawn n user-level processes named prefix0, prefix1, ... Stops at the first
+ * spawn that fails and returns its error; *spawned is how many were spawned.
  *
  */
-
-int 
-P2_Wait(int *pid, int *status) 
+int
+P2_SpawnN(char *prefix, int (*func)(void *), void **args, int n, int stackSize, int priority,
+          int flags, int *pids, int *spawned)
 {
     // check kernel mode
     if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
         USLOSS_IllegalInstruction();
     }
-    int rc=P1_SUCCESS;
-    rc= P1_Join(TAG_USER,pid,status);
-
-    return P1_SUCCESS;
+    char name[P1_MAXNAME+2];
+    int rc = P1_SUCCESS;
+    int i;
+    if (prefix == NULL) {
+        rc = P1_NAME_IS_NULL;
+    } else if (pids == NULL && n > 0) {
+        rc = P2_NULL_ADDRESS;
+    }
+    for (i = 0; rc == P1_SUCCESS && i < n; i++) {
+        if (snprintf(name, sizeof(name), "%s%d", prefix, i) > P1_MAXNAME) {
+            rc = P1_NAME_TOO_LONG;
+            break;
+        }
+        rc = P2_SpawnEx(name, func, args == NULL ? NULL : args[i], stackSize, priority, flags,
+                        &pids[i]);
+        if (rc != P1_SUCCESS) {
+            break;
+        }
+    }
+    if (spawned != NULL) {
+        *spawned = i;
+    }
+    return rc;
 }
 
 /*
- * P2_Terminate
+ * WaitSid
  *
- * Terminate a user-level process.
+ * Returns the semaphore a process waits on for its children, creating it if need be.
  *
  */
+static int
+WaitSid(int pid)
+{
+    int rc;
+    char name[P1_MAXNAME];
+    // both the process and whoever wakes it may get here first
+    int enabled = P2DisableInterrupts();
+    if (waiters[pid].sid == -1) {
+        snprintf(name, sizeof(name), "Child_Wait_%d", pid);
+        rc = P1_SemCreate(name, 0, &waiters[pid].sid);
+        assert(rc == P1_SUCCESS);
+    }
+    P2RestoreInterrupts(enabled);
+    return waiters[pid].sid;
+}
 
-void 
-P2_Terminate(int status) 
+/*
+ * P2ProcPark
+ *
+ * Blocks the caller until P2ProcUnpark is called for it or the clock reaches deadline
+ * (never, if it is -1). Wakeups are counted, so one that comes before the caller
+ * blocks isn't lost, but one may also be left over from an earlier wait; callers
+ * check what they are waiting for again each time this returns.
+ *
+ */
+int
+P2ProcPark(int deadline)
 {
-    // check kernel mode
     if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
         USLOSS_IllegalInstruction();
     }
-    P1_Quit(status);
+    int rc;
+    int self = P1_GetPid();
+    int sid = WaitSid(self);
+    if (deadline != -1 && Now() >= deadline) {
+        return P2_TIMEOUT;
+    }
+    waiters[self].deadline = deadline;
+    rc = P1_P(sid);
+    assert(rc == P1_SUCCESS);
+    waiters[self].deadline = -1;
+    if (deadline != -1 && Now() >= deadline) {
+        return P2_TIMEOUT;
+    }
+    return P1_SUCCESS;
 }
 
 /*
- * SpawnStub
+ * P2ProcUnpark
  *
- * Stub for Sys_Spawn system call. 
+ * Wakes pid from P2ProcPark, or makes its next P2ProcPark return at once.
  *
  */
-static void 
-SpawnStub(USLOSS_Sysargs *sysargs) 
+void
+P2ProcUnpark(int pid)
 {
-    int (*func)(void *) = sysargs->arg1;
-    void *arg = sysargs->arg2;
-    int stackSize = (int) sysargs->arg3;
-    int priority = (int) sysargs->arg4;
-    char *name = sysargs->arg5;
-    int pid;
-    int rc = P2_Spawn(name, func, arg, stackSize, priority, &pid);
-    if (rc == P1_SUCCESS) {
-        sysargs->arg1 = (void *) pid;
-    }
-    sysargs->arg4 = (void *) rc;
+    int rc;
+    rc = P1_V(WaitSid(pid));
+    assert(rc == P1_SUCCESS);
 }
 
-static void 
-TerminateStub(USLOSS_Sysargs *sysargs)
+/*
+ * FindChild
+ *
+ * Checks whether the caller has a user-level child that matches pid (-1 matches any).
+ * Returns P1_NO_CHILDREN or P1_INVALID_PID if not; otherwise *quit is set if a
+ * matching child has quit or is quitting.
+ *
+ */
+static int
+FindChild(int self, int pid, int *quit)
 {
-    P2_Terminate((int) sysargs->arg1);
+    int rc;
+    int found = FALSE;
+    P1_ProcInfo info;
+    P1_ProcInfo child;
+    *quit = FALSE;
+    rc = P1_GetProcInfo(self, &info);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < info.numChildren; i++) {
+        int c = info.children[i];
+        if (pid != -1 && c != pid) {
+            continue;
+        }
+        rc = P1_GetProcInfo(c, &child);
+        if (rc != P1_SUCCESS || child.tag != TAG_USER) {
+            continue;
+        }
+        found = TRUE;
+        if (child.state == P1_STATE_QUIT || waiters[c].terminating) {
+            *quit = TRUE;
+            break;
+        }
+    }
+    if (!found) {
+        return pid == -1 ? P1_NO_CHILDREN : P1_INVALID_PID;
+    }
+    return P1_SUCCESS;
 }
 
-static void 
-WaitStub(USLOSS_Sysargs *sysargs)
+/*
+ * Reap
+ *
+ * Joins children until one that matches pid comes back, keeping the others for
+ * later waits. Only called once a matching child has quit or is quitting.
+ *
+ */
+static int
+Reap(int self, int pid, int *childPid, int *status)
 {
-    int pid;
-    int status;
     int rc;
-    rc=P2_Wait(&pid,&status);
-    sysargs->arg1=(void *) pid;
-    sysargs->arg2=(void *) status;
-    sysargs->arg4=(void *) rc;
+    int p;
+    int s;
+    for (;;) {
+        rc = P1_Join(TAG_USER, &p, &s);
+        if (rc != P1_SUCCESS) {
+            return rc;
+        }
+        waiters[p].terminating = FALSE;
+        if (pid == -1 || p == pid) {
+            *childPid = p;
+            *status = s;
+            return P1_SUCCESS;
+        }
+        int i;
+        for (i = 0; i < MAX_REAPED && reaped[i].parent != -1; i++) {
+        }
+        assert(i < MAX_REAPED);
+        reaped[i].parent = self;
+        reaped[i].pid = p;
+        reaped[i].status = s;
+    }
 }
 
-static void 
-ProcInfoStub(USLOSS_Sysargs *sysargs)
+/*
+ * P2_WaitEx
+ *
+ * Wait for a user-level child, or a specific one, with an optional timeout.
+ *
+ */
+int
+P2_WaitEx(int pid, int timeout, int *childPid, int *status)
 {
-    int pid = (int) sysargs->arg1;
-    P1_ProcInfo *info = (P1_ProcInfo*) sysargs->arg2;
-    sysargs->arg4=(void *) P1_GetProcInfo(pid,info);
-
+    // check kernel mode
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc;
+    int self = P1_GetPid();
+    int deadline = timeout > 0 ? Now() + timeout : -1;
+    if (childPid == NULL || status == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (timeout < -1) {
+        return P2_INVALID_TIMEOUT;
+    }
+    WaitSid(self);
+    P2_TRACE(P2_TRACE_WAIT, 'B', pid);
+    rc = WaitFor(self, pid, timeout, deadline, childPid, status);
+    P2_TRACE(P2_TRACE_WAIT, 'E', pid);
+    return rc;
 }
 
-static void 
-GetPidStub(USLOSS_Sysargs *sysargs)
+/*
+ * WaitFor
+ *
+ * Body of P2_WaitEx.
+ *
+ */
+static int
+WaitFor(int self, int pid, int timeout, int deadline, int *childPid, int *status)
 {
-    sysargs->arg1 = (void *) P1_GetPid();
+    int rc;
+    int quit;
+    int free;
+    for (;;) {
+        // children that were reaped earlier come first
+        free = 0;
+        for (int i = 0; i < MAX_REAPED; i++) {
+            if (reaped[i].parent == -1) {
+                free++;
+            } else if (reaped[i].parent == self && (pid == -1 || reaped[i].pid == pid)) {
+                *childPid = reaped[i].pid;
+                *status = reaped[i].status;
+                reaped[i].parent = -1;
+                return P1_SUCCESS;
+            }
+        }
+        rc = FindChild(self, pid, &quit);
+        if (rc != P1_SUCCESS) {
+            return rc;
+        }
+        if (quit) {
+            // reaping other children on the way to pid needs room to keep them
+            if (pid != -1 && free < P1_MAXPROC) {
+                return P1_TOO_MANY_PROCESSES;
+            }
+            return Reap(self, pid, childPid, status);
+        }
+        if (timeout == 0) {
+            return P2_WOULD_BLOCK;
+        }
+        // wakeups may be stale, so look again whenever one arrives
+        rc = P2ProcPark(deadline);
+        if (rc != P1_SUCCESS) {
+            return rc;
+        }
+    }
+}
+
+/*
+ * P2_WaitMany
+ *
+ * Wait for each of several user-level children.
+ *
+ */
+int
+P2_WaitMany(int *pids, int *statuses, int n, int *reaped)
+{
+    // check kernel mode
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc = P1_SUCCESS;
+    int pid;
+    int i;
+    if (pids == NULL || statuses == NULL || reaped == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    for (i = 0; i < n; i++) {
+        rc = P2_WaitEx(pids[i], -1, &pid, &statuses[i]);
+        if (rc != P1_SUCCESS) {
+            break;
+        }
+    }
+    *reaped = i;
+    return rc;
+}
+
+/*
+ * P2ProcTick
+ *
+ * Called by the clock driver on every tick to end timed waits whose time is up.
+ *
+ */
+void
+P2ProcTick(int now)
+{
+    int rc;
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        if (waiters[i].deadline != -1 && waiters[i].deadline <= now) {
+            waiters[i].deadline = -1;
+            rc = P1_V(waiters[i].sid);
+            assert(rc == P1_SUCCESS);
+        }
+    }
+}
+
+/*
+ * P2_Wait
+ *
+ * Wait for a user-level process.
+ *
+ */
+
+int 
+P2_Wait(int *pid, int *status) 
+{
+    // check kernel mode
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    return P2_WaitEx(-1, -1, pid, status);
+}
+
+/*
+ * P2_Terminate
+ *
+ * Terminate a user-level process.
+ *
+ */
+
+void 
+P2_Terminate(int status) 
+{
+    // check kernel mode
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc;
+    int self = P1_GetPid();
+    P1_ProcInfo info;
+    // children it reaped but never waited for are forgotten
+    for (int i = 0; i < MAX_REAPED; i++) {
+        if (reaped[i].parent == self) {
+            reaped[i].parent = -1;
+        }
+    }
+    P2_TRACE(P2_TRACE_TERMINATE, 'i', status);
+    // wake the parent in case it is waiting; it joins us once we have quit
+    waiters[self].terminating = TRUE;
+    rc = P1_GetProcInfo(self, &info);
+    assert(rc == P1_SUCCESS);
+    if (info.parent >= 0 && info.parent < P1_MAXPROC && waiters[info.parent].sid != -1) {
+        rc = P1_V(waiters[info.parent].sid);
+        assert(rc == P1_SUCCESS);
+    }
+    P1_Quit(status);
+}
+
+/*
+ * ReaperMain
+ *
+ * Body of the reaper. Spawns detached processes on request, so that they are its
+ * children, and joins them whenever one quits.
+ *
+ */
+static int
+ReaperMain(void *arg)
+{
+    int rc;
+    int pid;
+    int status;
+    int sid = WaitSid(P1_GetPid());
+    rc = P1_V(reaper.doneSid);
+    assert(rc == P1_SUCCESS);
+    for (;;) {
+        // woken by a request, or by a child in P2_Terminate
+        rc = P1_P(sid);
+        assert(rc == P1_SUCCESS);
+        if (reaper.name != NULL) {
+            reaper.rc = P2_SpawnEx(reaper.name, reaper.func, reaper.arg, reaper.stackSize,
+                                   reaper.priority, P2_SPAWN_DETACHED, &reaper.child);
+            reaper.name = NULL;
+            rc = P1_V(reaper.doneSid);
+            assert(rc == P1_SUCCESS);
+        }
+        while (P2_WaitEx(-1, 0, &pid, &status) == P1_SUCCESS) {
+        }
+        if (reaper.stop) {
+            while (P2_Wait(&pid, &status) == P1_SUCCESS) {
+            }
+            rc = P1_V(reaper.doneSid);
+            assert(rc == P1_SUCCESS);
+            return 0;
+        }
+    }
+}
+
+/*
+ * SpawnDetached
+ *
+ * Has the reaper spawn a process, starting the reaper first if need be.
+ *
+ */
+static int
+SpawnDetached(char *name, int (*func)(void *), void *arg, int stackSize, int priority, int *pid)
+{
+    int rc;
+    if (name == NULL) {
+        return P1_NAME_IS_NULL;
+    }
+    rc = P1_P(reaper.mutex);
+    assert(rc == P1_SUCCESS);
+    if (reaper.pid == -1) {
+        reaper.stop = FALSE;
+        rc = P1_Fork("Reaper", ReaperMain, NULL, USLOSS_MIN_STACK, 2, TAG_KERNEL, &reaper.pid);
+        if (rc != P1_SUCCESS) {
+            reaper.pid = -1;
+            int fork = rc;
+            rc = P1_V(reaper.mutex);
+            assert(rc == P1_SUCCESS);
+            return fork;
+        }
+        // wait until it has its semaphore
+        rc = P1_P(reaper.doneSid);
+        assert(rc == P1_SUCCESS);
+    }
+    reaper.func = func;
+    reaper.arg = arg;
+    reaper.stackSize = stackSize;
+    reaper.priority = priority;
+    reaper.name = name;
+    P2ProcUnpark(reaper.pid);
+    rc = P1_P(reaper.doneSid);
+    assert(rc == P1_SUCCESS);
+    int result = reaper.rc;
+    if (result == P1_SUCCESS) {
+        *pid = reaper.child;
+    }
+    rc = P1_V(reaper.mutex);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * P2ProcShutdown
+ *
+ * Stops the reaper, if it was started, once all detached processes have quit.
+ *
+ */
+void
+P2ProcShutdown(void)
+{
+    int rc;
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    rc = P1_P(reaper.mutex);
+    assert(rc == P1_SUCCESS);
+    if (reaper.pid != -1) {
+        reaper.stop = TRUE;
+        P2ProcUnpark(reaper.pid);
+        rc = P1_P(reaper.doneSid);
+        assert(rc == P1_SUCCESS);
+        reaper.pid = -1;
+    }
+    rc = P1_V(reaper.mutex);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * P2_ProcSnapshot
+ *
+ * Copies the entries of the live processes into buf, with interrupts off so that
+ * nothing changes in the middle.
+ *
+ */
+int
+P2_ProcSnapshot(P2_ProcEntry *buf, int max, int flags, int *count)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc;
+    int n = 0;
+    P1_ProcInfo info;
+    if (count == NULL || (buf == NULL && max > 0)) {
+        return P2_NULL_ADDRESS;
+    }
+    if (flags & ~P2_SNAPSHOT_CHILDREN) {
+        return P2_INVALID_FLAGS;
+    }
+    int enabled = P2DisableInterrupts();
+    for (int pid = 0; pid < P1_MAXPROC; pid++) {
+        rc = P1_GetProcInfo(pid, &info);
+        if (rc != P1_SUCCESS || info.state == P1_STATE_FREE) {
+            continue;
+        }
+        if (n < max) {
+            P2_ProcEntry *entry = &buf[n];
+            entry->pid = pid;
+            if (flags & P2_SNAPSHOT_CHILDREN) {
+                entry->info = info;
+            } else {
+                memcpy(&entry->info, &info, offsetof(P1_ProcInfo, children));
+                entry->info.numChildren = info.numChildren;
+            }
+        }
+        n++;
+    }
+    P2RestoreInterrupts(enabled);
+    *count = n;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_ProcStatsGet
+ *
+ * Returns the accounting counters of a process.
+ *
+ */
+int
+P2_ProcStatsGet(int pid, P2_ProcStats *stats)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (pid < 0 || pid >= P1_MAXPROC) {
+        return P1_INVALID_PID;
+    }
+    if (stats == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    *stats = procStats[pid];
+    P2RestoreInterrupts(enabled);
+    return P1_SUCCESS;
+}
+
+/*
+ * P2ProcStatsFor
+ *
+ * Returns the accounting counters of a process, for the other layers to add to.
+ *
+ */
+P2_ProcStats *
+P2ProcStatsFor(int pid)
+{
+    assert(pid >= 0 && pid < P1_MAXPROC);
+    return &procStats[pid];
+}
+
+#define POOL_TASKS P1_MAXPROC
+
+// the pool the first P2_PoolSubmit starts, if P2PoolInit hasn't started one
+#define POOL_WORKERS    4
+#define POOL_PRIORITY   3
+
+#define TASK_FREE       0
+#define TASK_QUEUED     1
+#define TASK_RUNNING    2
+#define TASK_DONE       3
+
+typedef struct Task {
+    int state;
+    int generation;     // bumped when the task is joined, so old tickets go stale
+    int joining;
+    int (*func)(void *);
+    void *arg;
+    int result;
+    int doneSid;        // V'd when the task is done
+    int next;           // next queued task
+} Task;
+
+typedef struct Pool {
+    int running;
+    int stopping;
+    int manager;        // pid of PoolManager, whose children are the workers
+    int workers;
+    int priority;
+    int rc;             // result of spawning the workers
+    int pids[P1_MAXPROC];
+    Task tasks[POOL_TASKS];
+    int head;           // queue of tasks waiting for a worker
+    int tail;
+    int workSid;        // one per queued task, plus one per worker at shutdown
+    int freeSid;        // one per free task
+    int readySid;       // V'd by the manager once the workers are spawned
+    int stopSid;        // V'd to tell the manager to stop the workers
+    int exitSid;        // V'd by the manager when they have all quit
+} Pool;
+
+static Pool pool;
+
+/*
+ * PoolWorker
+ *
+ * Body of each pooled process. Runs in user mode, handing back the result of the
+ * previous task and getting the next one in the same trap, until the pool shuts down.
+ *
+ */
+static int
+PoolWorker(void *arg)
+{
+    USLOSS_Sysargs sa;
+    int (*func)(void *);
+    int ticket = -1;
+    int result = 0;
+
+    for (;;) {
+        sa.number = SYS_POOL;
+        sa.arg1 = (void *) ticket;
+        sa.arg2 = (void *) result;
+        sa.arg5 = (void *) P2_POOL_NEXT;
+        USLOSS_Syscall(&sa);
+        if ((int) sa.arg4 != P1_SUCCESS) {
+            break;
+        }
+        func = sa.arg1;
+        ticket = (int) sa.arg3;
+        result = func(sa.arg2);
+    }
+    return 0;
+}
+
+/*
+ * PoolManager
+ *
+ * Kernel process that owns the pool's workers, so that they are not children of
+ * whoever called P2PoolInit. Spawns them, then waits to be told to stop and reaps them.
+ *
+ */
+static int
+PoolManager(void *arg)
+{
+    int rc;
+    int pid;
+    int status;
+    int spawned;
+    // before any worker can ask for a task
+    pool.manager = P1_GetPid();
+    pool.rc = P2_SpawnN("Pool_Worker", PoolWorker, NULL, pool.workers, 4*USLOSS_MIN_STACK,
+                        pool.priority, 0, pool.pids, &spawned);
+    pool.workers = spawned;
+    rc = P1_V(pool.readySid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_P(pool.stopSid);
+    assert(rc == P1_SUCCESS);
+    // workers that find the queue empty once stopping is set quit
+    pool.stopping = TRUE;
+    for (int i = 0; i < spawned; i++) {
+        rc = P1_V(pool.workSid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (int i = 0; i < spawned; i++) {
+        rc = P2_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+    }
+    rc = P1_V(pool.exitSid);
+    assert(rc == P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * PoolStart
+ *
+ * Starts a pool of workers user processes at the given priority. The caller holds
+ * poolMutex.
+ *
+ */
+static int
+PoolStart(int workers, int priority)
+{
+    int rc;
+    int pid;
+    char name[P1_MAXNAME];
+    if (pool.running) {
+        return P1_INVALID_STATE;
+    }
+    if (workers <= 0 || workers >= P1_MAXPROC) {
+        return P1_TOO_MANY_PROCESSES;
+    }
+    memset(&pool, 0, sizeof(pool));
+    pool.workers = workers;
+    pool.priority = priority;
+    pool.head = -1;
+    pool.tail = -1;
+    rc = P1_SemCreate("Pool_Work", 0, &pool.workSid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemCreate("Pool_Free", POOL_TASKS, &pool.freeSid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemCreate("Pool_Ready", 0, &pool.readySid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemCreate("Pool_Stop", 0, &pool.stopSid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemCreate("Pool_Exit", 0, &pool.exitSid);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < POOL_TASKS; i++) {
+        snprintf(name, sizeof(name), "Pool_Task_%d", i);
+        rc = P1_SemCreate(name, 0, &pool.tasks[i].doneSid);
+        assert(rc == P1_SUCCESS);
+    }
+    pool.manager = -1;
+    pool.running = TRUE;
+    rc = P1_Fork("Pool_Manager", PoolManager, NULL, 2*USLOSS_MIN_STACK, 2, TAG_KERNEL, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_P(pool.readySid);
+    assert(rc == P1_SUCCESS);
+    if (pool.rc != P1_SUCCESS) {
+        rc = pool.rc;
+        PoolStop();
+        return rc;
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * P2PoolInit
+ *
+ * Starts a pool of workers user processes at the given priority. Without it the first
+ * P2_PoolSubmit starts a pool of POOL_WORKERS.
+ *
+ */
+int
+P2PoolInit(int workers, int priority)
+{
+    int rc;
+    int result;
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    rc = P1_P(poolMutex);
+    assert(rc == P1_SUCCESS);
+    result = PoolStart(workers, priority);
+    rc = P1_V(poolMutex);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * PoolStop
+ *
+ * Stops the pool, if it is running, once the tasks already submitted have run. The
+ * caller holds poolMutex.
+ *
+ */
+static void
+PoolStop(void)
+{
+    int rc;
+    if (!pool.running) {
+        return;
+    }
+    rc = P1_V(pool.stopSid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_P(pool.exitSid);
+    assert(rc == P1_SUCCESS);
+    rc = P1_SemFree(pool.workSid);
+    rc = P1_SemFree(pool.freeSid);
+    rc = P1_SemFree(pool.readySid);
+    rc = P1_SemFree(pool.stopSid);
+    rc = P1_SemFree(pool.exitSid);
+    for (int i = 0; i < POOL_TASKS; i++) {
+        rc = P1_SemFree(pool.tasks[i].doneSid);
+    }
+    pool.manager = -1;
+    pool.running = FALSE;
+}
+
+/*
+ * P2PoolShutdown
+ *
+ * Stops the pool, if it was started, once the tasks already submitted have run. Tasks
+ * submitted while it is stopping fail with P1_INVALID_STATE.
+ *
+ */
+void
+P2PoolShutdown(void)
+{
+    int rc;
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    rc = P1_P(poolMutex);
+    assert(rc == P1_SUCCESS);
+    PoolStop();
+    rc = P1_V(poolMutex);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * P2_PoolSubmit
+ *
+ * Queues func(arg) for the next idle worker and returns its ticket. Starts the pool
+ * if it isn't running.
+ *
+ */
+int
+P2_PoolSubmit(int (*func)(void *), void *arg, int *ticket)
+{
+    int rc;
+    int enabled;
+    int slot;
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (func == NULL || ticket == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (!pool.running) {
+        rc = P1_P(poolMutex);
+        assert(rc == P1_SUCCESS);
+        int result = pool.running ? P1_SUCCESS : PoolStart(POOL_WORKERS, POOL_PRIORITY);
+        rc = P1_V(poolMutex);
+        assert(rc == P1_SUCCESS);
+        if (result != P1_SUCCESS) {
+            return result;
+        }
+    }
+    if (pool.stopping) {
+        return P1_INVALID_STATE;
+    }
+    rc = P1_P(pool.freeSid);
+    if (rc != P1_SUCCESS) {
+        return rc;
+    }
+    enabled = P2DisableInterrupts();
+    for (slot = 0; pool.tasks[slot].state != TASK_FREE; slot++) {
+    }
+    Task *task = &pool.tasks[slot];
+    task->state = TASK_QUEUED;
+    task->func = func;
+    task->arg = arg;
+    task->next = -1;
+    if (pool.tail == -1) {
+        pool.head = slot;
+    } else {
+        pool.tasks[pool.tail].next = slot;
+    }
+    pool.tail = slot;
+    *ticket = task->generation * POOL_TASKS + slot;
+    P2RestoreInterrupts(enabled);
+    rc = P1_V(pool.workSid);
+    assert(rc == P1_SUCCESS);
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_PoolJoin
+ *
+ * Waits for the task with the given ticket to finish and returns its result.
+ *
+ */
+int
+P2_PoolJoin(int ticket, int *result)
+{
+    int rc;
+    int enabled;
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (!pool.running) {
+        return P1_INVALID_STATE;
+    }
+    if (result == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (ticket < 0) {
+        return P2_INVALID_TICKET;
+    }
+    Task *task = &pool.tasks[ticket % POOL_TASKS];
+    enabled = P2DisableInterrupts();
+    if (task->state == TASK_FREE || task->generation != ticket / POOL_TASKS || task->joining) {
+        P2RestoreInterrupts(enabled);
+        return P2_INVALID_TICKET;
+    }
+    task->joining = TRUE;
+    P2RestoreInterrupts(enabled);
+    rc = P1_P(task->doneSid);
+    assert(rc == P1_SUCCESS);
+    *result = task->result;
+    task->joining = FALSE;
+    task->generation++;
+    task->state = TASK_FREE;
+    rc = P1_V(pool.freeSid);
+    assert(rc == P1_SUCCESS);
+    return P1_SUCCESS;
+}
+
+/*
+ * PoolNext
+ *
+ * Called by a worker to finish the task with the given ticket, if any, and wait for the
+ * next one. Returns P1_WAIT_ABORTED when the pool is shutting down, and
+ * P2_INVALID_SYSCALL if the caller isn't one of the pool's workers.
+ *
+ */
+static int
+PoolNext(int ticket, int result, int (**func)(void *), void **arg, int *next)
+{
+    int rc;
+    int enabled;
+    P1_ProcInfo info;
+    rc = P1_GetProcInfo(P1_GetPid(), &info);
+    assert(rc == P1_SUCCESS);
+    if (!pool.running || pool.manager == -1 || info.parent != pool.manager) {
+        return P2_INVALID_SYSCALL;
+    }
+    if (ticket >= 0) {
+        Task *task = &pool.tasks[ticket % POOL_TASKS];
+        if (task->state != TASK_RUNNING || task->generation != ticket / POOL_TASKS) {
+            return P2_INVALID_TICKET;
+        }
+        task->result = result;
+        task->state = TASK_DONE;
+        rc = P1_V(task->doneSid);
+        assert(rc == P1_SUCCESS);
+    }
+    rc = P1_P(pool.workSid);
+    assert(rc == P1_SUCCESS);
+    enabled = P2DisableInterrupts();
+    if (pool.head == -1) {
+        // only happens once the manager is stopping the workers
+        P2RestoreInterrupts(enabled);
+        return P1_WAIT_ABORTED;
+    }
+    int slot = pool.head;
+    Task *task = &pool.tasks[slot];
+    pool.head = task->next;
+    if (pool.head == -1) {
+        pool.tail = -1;
+    }
+    task->state = TASK_RUNNING;
+    *func = task->func;
+    *arg = task->arg;
+    *next = task->generation * POOL_TASKS + slot;
+    P2RestoreInterrupts(enabled);
+    return P1_SUCCESS;
+}
+
+/*
+ * SpawnStub
+ *
+ * Stub for Sys_Spawn system call. 
+ *
+ */
+static void 
+SpawnStub(USLOSS_Sysargs *sysargs) 
+{
+    int (*func)(void *) = sysargs->arg1;
+    void *arg = sysargs->arg2;
+    int stackSize = (int) sysargs->arg3;
+    int priority = (int) sysargs->arg4;
+    char *name = sysargs->arg5;
+    int pid;
+    int rc = P2_Spawn(name, func, arg, stackSize, priority, &pid);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) pid;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * ProcSnapshotStub
+ *
+ * Stub for Sys_ProcSnapshot.
+ *
+ */
+static void
+ProcSnapshotStub(USLOSS_Sysargs *sysargs)
+{
+    int count = 0;
+    int rc;
+    rc = P2_ProcSnapshot((P2_ProcEntry *) sysargs->arg1, (int) sysargs->arg2,
+                         (int) sysargs->arg3, &count);
+    sysargs->arg1 = (void *) count;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * ProcStatsStub
+ *
+ * Stub for Sys_ProcStats.
+ *
+ */
+static void
+ProcStatsStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg4 = (void *) P2_ProcStatsGet((int) sysargs->arg1, (P2_ProcStats *) sysargs->arg2);
+}
+
+/*
+ * SpawnExStub
+ *
+ * Stub for Sys_SpawnEx.
+ *
+ */
+static void
+SpawnExStub(USLOSS_Sysargs *sysargs)
+{
+    P2_SpawnRequest *req = (P2_SpawnRequest *) sysargs->arg1;
+    int rc;
+    if (req == NULL || req->args == NULL || req->pids == NULL) {
+        rc = P2_NULL_ADDRESS;
+    } else {
+        rc = P2_SpawnEx(req->name, req->func, req->args[0], req->stackSize, req->priority,
+                        req->flags, req->pids);
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * SpawnNStub
+ *
+ * Stub for Sys_SpawnN.
+ *
+ */
+static void
+SpawnNStub(USLOSS_Sysargs *sysargs)
+{
+    P2_SpawnRequest *req = (P2_SpawnRequest *) sysargs->arg1;
+    int spawned = 0;
+    int rc;
+    if (req == NULL) {
+        rc = P2_NULL_ADDRESS;
+    } else {
+        rc = P2_SpawnN(req->name, req->func, req->args, req->n, req->stackSize,
+                       req->priority, req->flags, req->pids, &spawned);
+    }
+    sysargs->arg1 = (void *) spawned;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * PoolStub
+ *
+ * Stub for the worker pool system calls. The operation is in arg5.
+ *
+ */
+static void
+PoolStub(USLOSS_Sysargs *sysargs)
+{
+    int ticket;
+    int result;
+    int rc;
+    int (*func)(void *);
+    void *arg;
+    switch ((int) sysargs->arg5) {
+        case P2_POOL_SUBMIT:
+            rc = P2_PoolSubmit(sysargs->arg1, sysargs->arg2, &ticket);
+            if (rc == P1_SUCCESS) {
+                sysargs->arg1 = (void *) ticket;
+            }
+            break;
+        case P2_POOL_JOIN:
+            rc = P2_PoolJoin((int) sysargs->arg1, &result);
+            if (rc == P1_SUCCESS) {
+                sysargs->arg1 = (void *) result;
+            }
+            break;
+        case P2_POOL_NEXT:
+            rc = PoolNext((int) sysargs->arg1, (int) sysargs->arg2, &func, &arg, &ticket);
+            if (rc == P1_SUCCESS) {
+                sysargs->arg1 = (void *) func;
+                sysargs->arg2 = arg;
+                sysargs->arg3 = (void *) ticket;
+            }
+            break;
+        default:
+            rc = P2_INVALID_SYSCALL;
+            break;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+TerminateStub(USLOSS_Sysargs *sysargs)
+{
+    P2_Terminate((int) sysargs->arg1);
+}
+
+static void 
+WaitStub(USLOSS_Sysargs *sysargs)
+{
+    int pid;
+    int status;
+    int rc;
+    rc=P2_Wait(&pid,&status);
+    sysargs->arg1=(void *) pid;
+    sysargs->arg2=(void *) status;
+    sysargs->arg4=(void *) rc;
+}
+
+/*
+ * WaitExStub
+ *
+ * Stub for Sys_WaitPid, Sys_WaitNoHang and Sys_WaitTimed.
+ *
+ */
+static void
+WaitExStub(USLOSS_Sysargs *sysargs)
+{
+    int pid;
+    int status;
+    int rc;
+    rc = P2_WaitEx((int) sysargs->arg1, (int) sysargs->arg2, &pid, &status);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) pid;
+        sysargs->arg2 = (void *) status;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WaitManyStub
+ *
+ * Stub for Sys_WaitMany.
+ *
+ */
+static void
+WaitManyStub(USLOSS_Sysargs *sysargs)
+{
+    int n = 0;
+    int rc;
+    rc = P2_WaitMany((int *) sysargs->arg1, (int *) sysargs->arg2, (int) sysargs->arg3, &n);
+    sysargs->arg1 = (void *) n;
+    sysargs->arg4 = (void *) rc;
+}
+
+static void 
+ProcInfoStub(USLOSS_Sysargs *sysargs)
+{
+    int pid = (int) sysargs->arg1;
+    P1_ProcInfo *info = (P1_ProcInfo*) sysargs->arg2;
+    sysargs->arg4=(void *) P1_GetProcInfo(pid,info);
+
+}
+
+static void 
+GetPidStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg1 = (void *) P1_GetPid();
+}
+
+/*
+ * ReportsStatus
+ *
+ * Returns whether a system call leaves a status in arg4. All of them do except these,
+ * which have nothing that can fail and leave arg4 as it was.
+ *
+ */
+static int
+ReportsStatus(int number)
+{
+    return number != SYS_GETPID && number != SYS_GETTIMEOFDAY && number != SYS_TERMINATE;
+}
+
+/*
+ * BatchStub
+ *
+ * Stub for Sys_Batch. Dispatches each of an array of system calls in order, leaving each
+ * one's results in its own USLOSS_Sysargs, and returns how many were dispatched.
+ *
+ */
+static void
+BatchStub(USLOSS_Sysargs *sysargs)
+{
+    USLOSS_Sysargs *calls = (USLOSS_Sysargs *) sysargs->arg1;
+    int n = (int) sysargs->arg2;
+    int flags = (int) sysargs->arg3;
+    int i;
+    if (calls == NULL) {
+        sysargs->arg4 = (void *) P2_NULL_ADDRESS;
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        if (calls[i].number == SYS_BATCH) {
+            calls[i].arg4 = (void *) P2_INVALID_SYSCALL;
+        } else {
+            Dispatch(&calls[i]);
+        }
+        // arg4 can be an argument, so only look at it if the call put a status there
+        if ((flags & P2_BATCH_STOP) && ReportsStatus(calls[i].number)
+            && (int) calls[i].arg4 < 0) {
+            i++;
+            break;
+        }
+    }
+    sysargs->arg1 = (void *) i;
+    sysargs->arg4 = (void *) P1_SUCCESS;
+}
+
+/*
+ * SyscallStatsStub
+ *
+ * Stub for Sys_SyscallStats.
+ *
+ */
+static void
+SyscallStatsStub(USLOSS_Sysargs *sysargs)
+{
+    int number = (int) sysargs->arg1;
+    P2_SyscallStats *stats = (P2_SyscallStats *) sysargs->arg2;
+    if (number <= 0 || number > USLOSS_MAX_SYSCALLS) {
+        sysargs->arg4 = (void *) P2_INVALID_SYSCALL;
+    } else if (stats == NULL) {
+        sysargs->arg4 = (void *) P2_NULL_ADDRESS;
+    } else {
+        *stats = syscallStats[number-1];
+        sysargs->arg4 = (void *) P1_SUCCESS;
+    }
 }
 
 /*
@@ -0,0 +1,118 @@
+/*
+ * bench_spawn.c
+ *
+ * Several parents spawn children as fast as they can, alternating between two entry
+ * points and between priorities above and below their own, so children preempt their
+ * parents and spawns from different parents interleave. Each child's exit status
+ * identifies the function and argument it was started with, and every parent checks
+ * them. Reports the spawn throughput.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+
+#define PARENTS     4
+#define CHILDREN    8       // per round
+#define ROUNDS      10
+
+static int passed = TRUE;
+
+int Even(void *arg) {
+    return 2 * (int) arg;
+}
+
+int Odd(void *arg) {
+    return 2 * (int) arg + 1;
+}
+
+/*
+ * Parent
+ *
+ * Spawns ROUNDS rounds of CHILDREN children and reaps each round.
+ */
+
+int Parent(void *arg) {
+    int rc, pid, status;
+    int pids[CHILDREN];
+    int expected[CHILDREN];
+    int base = (int) arg * ROUNDS * CHILDREN;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < CHILDREN; i++) {
+            int id = base + round * CHILDREN + i;
+            if (i % 2) {
+                rc = Sys_Spawn(MakeName("Odd", id), Odd, (void *) id, USLOSS_MIN_STACK, 5, &pids[i]);
+                expected[i] = 2 * id + 1;
+            } else {
+                rc = Sys_Spawn(MakeName("Even", id), Even, (void *) id, USLOSS_MIN_STACK, 2, &pids[i]);
+                expected[i] = 2 * id;
+            }
+            TEST(rc, P1_SUCCESS);
+        }
+        for (int i = 0; i < CHILDREN; i++) {
+            rc = Sys_Wait(&pid, &status);
+            TEST(rc, P1_SUCCESS);
+            int j;
+            for (j = 0; j < CHILDREN && pids[j] != pid; j++) {
+            }
+            TEST(j < CHILDREN, 1);
+            TEST(status, expected[j]);
+            pids[j] = -1;
+        }
+    }
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status;
+    int start, finish;
+
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < PARENTS; i++) {
+        rc = Sys_Spawn(MakeName("Parent", i), Parent, (void *) i, 2*USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i < PARENTS; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+        TEST(status, 0);
+    }
+    Sys_GetTimeOfDay(&finish);
+    int spawns = PARENTS * ROUNDS * CHILDREN;
+    USLOSS_Console("%d spawns in %d us (%d spawns/s).\n", spawns, finish - start,
+                   (int) (spawns * 1000000LL / (finish - start + 1)));
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
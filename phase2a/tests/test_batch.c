@@ -0,0 +1,104 @@
+/*
+ * test_batch.c
+ *
+ * Tests Sys_Batch, with and without P2_BATCH_STOP.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+static int passed = TRUE;
+
+static int p3Pid;
+
+/*
+ * Fill
+ *
+ * GetPID, GetProcInfo of ourselves, GetProcInfo of an invalid pid, an invalid
+ * system call, and GetTimeOfDay.
+ */
+
+static void Fill(USLOSS_Sysargs *calls, P1_ProcInfo *info)
+{
+    memset(calls, 0, 5 * sizeof(USLOSS_Sysargs));
+    calls[0].number = SYS_GETPID;
+    calls[1].number = SYS_GETPROCINFO;
+    calls[1].arg1 = (void *) p3Pid;
+    calls[1].arg2 = (void *) info;
+    calls[2].number = SYS_GETPROCINFO;
+    calls[2].arg1 = (void *) -1;
+    calls[2].arg2 = (void *) info;
+    calls[3].number = SYS_BATCH;
+    calls[4].number = SYS_GETTIMEOFDAY;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    USLOSS_Sysargs calls[5];
+    P1_ProcInfo info;
+    int rc, done;
+
+    Fill(calls, &info);
+    rc = Sys_Batch(calls, 5, 0, &done);
+    TEST(rc, P1_SUCCESS);
+    TEST(done, 5);
+    TEST((int) calls[0].arg1, p3Pid);
+    TEST((int) calls[1].arg4, P1_SUCCESS);
+    TEST(strcmp(info.name, "P3_Startup"), 0);
+    TEST((int) calls[2].arg4 < 0, 1);
+    TEST((int) calls[3].arg4, P2_INVALID_SYSCALL);
+    TEST((int) calls[4].arg1 > 0, 1);
+
+    Fill(calls, &info);
+    rc = Sys_Batch(calls, 5, P2_BATCH_STOP, &done);
+    TEST(rc, P1_SUCCESS);
+    TEST(done, 3);
+    TEST((int) calls[4].arg1, 0);
+
+    // GetPID leaves arg4 alone, so what was there doesn't stop the batch
+    Fill(calls, &info);
+    calls[0].arg4 = (void *) -1;
+    rc = Sys_Batch(calls, 2, P2_BATCH_STOP, &done);
+    TEST(rc, P1_SUCCESS);
+    TEST(done, 2);
+    TEST((int) calls[1].arg4, P1_SUCCESS);
+
+    rc = Sys_Batch(NULL, 5, 0, &done);
+    TEST(rc, P2_NULL_ADDRESS);
+    Sys_Terminate(11);
+    // does not get here
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * test_detach.c
+ *
+ * Tests detached processes: spawns many more of them than fit in the process table
+ * without ever waiting for them.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define DETACHED (3 * P1_MAXPROC)
+
+static int passed = TRUE;
+
+static int ran = 0;
+
+int Detached(void *arg) {
+    ran++;
+    return (int) arg;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    P2ProcShutdown();
+    TEST(ran, DETACHED + 1);
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status, child;
+
+    // these run as soon as they are spawned and are reaped right after
+    for (int i = 0; i < DETACHED; i++) {
+        rc = Sys_SpawnEx("Detached", Detached, (void *) i, USLOSS_MIN_STACK, 2,
+                         P2_SPAWN_DETACHED, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(ran, DETACHED);
+    rc = Sys_WaitNoHang(&pid, &status);
+    TEST(rc, P1_NO_CHILDREN);
+
+    // a detached process isn't the caller's child
+    rc = Sys_SpawnEx("Detached", Detached, NULL, USLOSS_MIN_STACK, 4, P2_SPAWN_DETACHED, &child);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_WaitPid(child, &status);
+    TEST(rc, P1_INVALID_PID);
+    rc = Sys_SpawnEx("Detached", Detached, NULL, USLOSS_MIN_STACK, 4, 0x100, &child);
+    TEST(rc, P2_INVALID_FLAGS);
+    Sys_Terminate(11);
+    // does not get here
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
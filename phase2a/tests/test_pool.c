@@ -0,0 +1,118 @@
+/*
+ * test_pool.c
+ *
+ * Tests the worker pool, and compares running short tasks on it with spawning a
+ * process for each one. Also checks that the first submission starts a pool if
+ * P2PoolInit wasn't called, and that only workers can ask for tasks.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define WORKERS 3
+#define TASKS   40
+
+static int passed = TRUE;
+
+int Square(void *arg) {
+    return (int) arg * (int) arg;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid, ticket, result;
+
+    P2ProcInit();
+    rc = P2PoolInit(WORKERS, 3);
+    TEST(rc, P1_SUCCESS);
+    rc = P2PoolInit(WORKERS, 3);
+    TEST(rc, P1_INVALID_STATE);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    P2PoolShutdown();
+
+    // started by the submission
+    rc = P2_PoolSubmit(Square, (void *) 7, &ticket);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_PoolJoin(ticket, &result);
+    TEST(rc, P1_SUCCESS);
+    TEST(result, 49);
+    P2PoolShutdown();
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int tickets[TASKS];
+    int rc, pid, status, result, start, pooled, spawned;
+
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < TASKS; i++) {
+        rc = Sys_PoolSubmit(Square, (void *) i, &tickets[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    // join them out of order
+    for (int i = TASKS - 1; i >= 0; i--) {
+        rc = Sys_PoolJoin(tickets[i], &result);
+        TEST(rc, P1_SUCCESS);
+        TEST(result, i * i);
+    }
+    Sys_GetTimeOfDay(&pooled);
+    pooled -= start;
+
+    // a ticket can only be joined once
+    rc = Sys_PoolJoin(tickets[0], &result);
+    TEST(rc, P2_INVALID_TICKET);
+    rc = Sys_PoolJoin(-1, &result);
+    TEST(rc, P2_INVALID_TICKET);
+    rc = Sys_PoolSubmit(NULL, NULL, &tickets[0]);
+    TEST(rc, P2_NULL_ADDRESS);
+
+    // we aren't a worker, so we can't take tasks
+    USLOSS_Sysargs sa;
+    sa.number = SYS_POOL;
+    sa.arg1 = (void *) -1;
+    sa.arg2 = (void *) 0;
+    sa.arg5 = (void *) P2_POOL_NEXT;
+    USLOSS_Syscall(&sa);
+    TEST((int) sa.arg4, P2_INVALID_SYSCALL);
+
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < TASKS; i++) {
+        rc = Sys_Spawn("Square", Square, (void *) i, USLOSS_MIN_STACK, 3, &pid);
+        TEST(rc, P1_SUCCESS);
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+        TEST(status, i * i);
+    }
+    Sys_GetTimeOfDay(&spawned);
+    spawned -= start;
+    USLOSS_Console("%d tasks: %d us on the pool, %d us spawning each one.\n", TASKS, pooled,
+                   spawned);
+    Sys_Terminate(11);
+    // does not get here
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * test_snapshot.c
+ *
+ * Tests Sys_ProcSnapshot against Sys_GetProcInfo.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define CHILDREN 3
+
+static int passed = TRUE;
+
+int Child(void *arg) {
+    return 0;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    static P2_ProcEntry entries[P1_MAXPROC];
+    P1_ProcInfo info;
+    int rc, self, pid, status, count, live;
+    int pids[CHILDREN];
+
+    // the children can't run until we wait for them
+    for (int i = 0; i < CHILDREN; i++) {
+        rc = Sys_Spawn(MakeName("Child", i), Child, NULL, USLOSS_MIN_STACK, 4, &pids[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    Sys_GetPID(&self);
+    live = 0;
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        rc = Sys_GetProcInfo(i, &info);
+        if (rc == P1_SUCCESS && info.state != P1_STATE_FREE) {
+            live++;
+        }
+    }
+
+    memset(entries, 0xff, sizeof(entries));
+    rc = Sys_ProcSnapshot(entries, P1_MAXPROC, 0, &count);
+    TEST(rc, P1_SUCCESS);
+    TEST(count, live);
+    for (int i = 0; i < count; i++) {
+        rc = Sys_GetProcInfo(entries[i].pid, &info);
+        TEST(rc, P1_SUCCESS);
+        TEST(strcmp(entries[i].info.name, info.name), 0);
+        TEST(entries[i].info.state, info.state);
+        TEST(entries[i].info.priority, info.priority);
+        TEST(entries[i].info.parent, info.parent);
+        TEST(entries[i].info.numChildren, info.numChildren);
+        // not asked for
+        TEST(entries[i].info.children[0], -1);
+    }
+
+    rc = Sys_ProcSnapshot(entries, P1_MAXPROC, P2_SNAPSHOT_CHILDREN, &count);
+    TEST(rc, P1_SUCCESS);
+    TEST(count, live);
+    for (int i = 0; i < count; i++) {
+        if (entries[i].pid == self) {
+            TEST(entries[i].info.numChildren, CHILDREN);
+            for (int j = 0; j < CHILDREN; j++) {
+                TEST(entries[i].info.children[j], pids[j]);
+            }
+        }
+    }
+
+    // too small a buffer still reports how many there are
+    rc = Sys_ProcSnapshot(entries, 1, 0, &count);
+    TEST(rc, P1_SUCCESS);
+    TEST(count, live);
+    rc = Sys_ProcSnapshot(NULL, 1, 0, &count);
+    TEST(rc, P2_NULL_ADDRESS);
+
+    for (int i = 0; i < CHILDREN; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    Sys_Terminate(11);
+    // does not get here
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * test_spawnn.c
+ *
+ * Tests Sys_SpawnN.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define WORKERS 12
+
+static int passed = TRUE;
+
+/*
+ * Worker
+ *
+ * Checks that it was named after its argument, and returns it.
+ */
+
+int Worker(void *arg) {
+    P1_ProcInfo info;
+    char name[P1_MAXNAME+1];
+    int rc, pid;
+
+    Sys_GetPID(&pid);
+    rc = Sys_GetProcInfo(pid, &info);
+    TEST(rc, P1_SUCCESS);
+    snprintf(name, sizeof(name), "Worker%d", (int) arg);
+    TEST(strcmp(info.name, name), 0);
+    return (int) arg;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ProcInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    void *args[WORKERS];
+    int pids[WORKERS];
+    int seen[WORKERS];
+    int rc, pid, status, spawned;
+
+    for (int i = 0; i < WORKERS; i++) {
+        args[i] = (void *) i;
+        seen[i] = FALSE;
+    }
+    rc = Sys_SpawnN("Worker", Worker, args, WORKERS, USLOSS_MIN_STACK, 4, 0, pids, &spawned);
+    TEST(rc, P1_SUCCESS);
+    TEST(spawned, WORKERS);
+    for (int i = 0; i < WORKERS; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+        TEST(status >= 0 && status < WORKERS, 1);
+        TEST(pids[status], pid);
+        TEST(seen[status], FALSE);
+        seen[status] = TRUE;
+    }
+
+    rc = Sys_SpawnN("Worker", Worker, args, WORKERS, USLOSS_MIN_STACK, 4, 0, NULL, &spawned);
+    TEST(rc, P2_NULL_ADDRESS);
+    TEST(spawned, 0);
+
+    // the first spawn fails, so none are attempted after it
+    rc = Sys_SpawnN("Worker", Worker, args, WORKERS, 0, 4, 0, pids, &spawned);
+    TEST(rc, P1_INVALID_STACK);
+    TEST(spawned, 0);
+    Sys_Terminate(11);
+    // does not get here
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
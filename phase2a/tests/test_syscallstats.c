@@ -0,0 +1,103 @@
+/*
+ * test_syscallstats.c
+ *
+ * Tests the per-system call statistics: with them enabled, a known number of calls
+ * shows up in the counts and the histogram, and Sys_SyscallStats rejects bad
+ * arguments.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define CALLS   10
+
+static int passed = TRUE;
+
+/*
+ * Check
+ *
+ * Checks that stats add up for count calls.
+ */
+static void
+Check(P2_SyscallStats *stats, int count)
+{
+    int sum = 0;
+    int bucket;
+    TEST(stats->count, count);
+    for (int i = 0; i < P2_HIST_BUCKETS; i++) {
+        sum += stats->hist[i];
+    }
+    TEST(sum, count);
+    TEST(stats->max <= stats->total, 1);
+    // the longest call is in the bucket for its time
+    for (bucket = 0; bucket < P2_HIST_BUCKETS - 1 && stats->max >= (1 << bucket); bucket++) {
+    }
+    TEST(stats->hist[bucket] > 0, 1);
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ProcInit();
+    P2SyscallStatsEnable(TRUE);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    P2SyscallStatsEnable(FALSE);
+    P2SyscallStatsDump();
+    PASSED();
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    P2_SyscallStats stats;
+    int rc, pid;
+
+    rc = Sys_SyscallStats(SYS_GETPID, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.count, 0);
+    for (int i = 0; i < CALLS; i++) {
+        Sys_GetPID(&pid);
+    }
+    rc = Sys_SyscallStats(SYS_GETPID, &stats);
+    TEST(rc, P1_SUCCESS);
+    Check(&stats, CALLS);
+
+    // a call is counted once it returns, so this one isn't yet
+    rc = Sys_SyscallStats(SYS_SYSCALLSTATS, &stats);
+    TEST(rc, P1_SUCCESS);
+    Check(&stats, 2);
+
+    rc = Sys_SyscallStats(0, &stats);
+    TEST(rc, P2_INVALID_SYSCALL);
+    rc = Sys_SyscallStats(USLOSS_MAX_SYSCALLS + 1, &stats);
+    TEST(rc, P2_INVALID_SYSCALL);
+    rc = Sys_SyscallStats(SYS_GETPID, NULL);
+    TEST(rc, P2_NULL_ADDRESS);
+    Sys_Terminate(11);
+    // does not get here
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * test_trace.c
+ *
+ * Traces a few spawns, waits and system calls, checks that they were all recorded,
+ * and dumps them as Chrome trace JSON. The output can be loaded into chrome://tracing
+ * or Perfetto.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2Ext.h"
+
+#define CHILDREN 3
+
+static int passed = TRUE;
+
+int Child(void *arg) {
+    int pid;
+    Sys_GetPID(&pid);
+    return (int) arg;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status;
+
+    for (int i = 0; i < CHILDREN; i++) {
+        rc = Sys_Spawn(MakeName("Child", i), Child, (void *) i, USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i < CHILDREN; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ProcInit();
+    // nothing to dump yet
+    P2TraceDump();
+    TEST(P2TraceCount(P2_TRACE_SPAWN, 'i'), 0);
+    P2TraceEnable(TRUE);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 11);
+    TEST(waitPid, p3Pid);
+    P2TraceEnable(FALSE);
+    // P3_Startup and its children were each spawned and waited for
+    TEST(P2TraceCount(P2_TRACE_SPAWN, 'i'), CHILDREN + 1);
+    TEST(P2TraceCount(P2_TRACE_WAIT, 'B'), CHILDREN + 1);
+    TEST(P2TraceCount(P2_TRACE_WAIT, 'E'), CHILDREN + 1);
+    TEST(P2TraceCount(P2_TRACE_TERMINATE, 'i'), CHILDREN + 1);
+    // at least their spawns, waits and GetPIDs, which all return
+    TEST(P2TraceCount(P2_TRACE_SYSCALL, 'B') >= 3 * CHILDREN, 1);
+    TEST(P2TraceCount(P2_TRACE_SYSCALL, 'E') >= 3 * CHILDREN, 1);
+    // tracing is off, so this isn't recorded
+    rc = P2_Spawn("Child", Child, NULL, USLOSS_MIN_STACK, 4, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(P2TraceCount(P2_TRACE_SPAWN, 'i'), CHILDREN + 1);
+    P2TraceDump();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
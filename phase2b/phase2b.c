@@ -7,6 +7,7 @@
 #include <phase1.h>
 
 #include "phase2Int.h"
+#include "phase2Ext.h"
 
 
 static int      ClockDriver(void *);
@@ -99,6 +100,7 @@ ClockDriver(void *arg)
             if(sleepers[i].pid!=-1){
                 // free sem after waking up
                 if(sleepers[i].wakeTime<=now){
+                    P2_TRACE(P2_TRACE_WAKE, 'i', sleepers[i].pid);
                     rc = P1_V(sleepers[i].sid);
                     //assert(rc ==P1_SUCCESS);
                     rc = P1_SemFree(sleepers[i].sid);
@@ -109,6 +111,8 @@ ClockDriver(void *arg)
                 }
             }
         }
+        // and end timed parks, such as waits for children with a timeout
+        P2ProcTick(now);
     }
     return P1_SUCCESS;
 }
@@ -140,8 +144,13 @@ P2_Sleep(int seconds)
     rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV,0,&time);
     //assert(rc ==P1_SUCCESS);
     sleepers[pid].wakeTime=time+seconds*1000000;
+    P2_TRACE(P2_TRACE_SLEEP, 'B', seconds);
     rc = P1_P(sleepers[pid].sid);
     //assert(rc ==P1_SUCCESS);
+    P2_TRACE(P2_TRACE_SLEEP, 'E', seconds);
+    int now;
+    rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV,0,&now);
+    P2ProcStatsFor(pid)->sleepTime += now - time;
     return P1_SUCCESS;
 }
 
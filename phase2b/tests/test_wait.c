@@ -0,0 +1,112 @@
+/*
+ * test_wait.c
+ *
+ * Tests Sys_WaitPid, Sys_WaitNoHang, Sys_WaitTimed and Sys_WaitMany.
+ */
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define MANY 4
+
+static int passed = TRUE;
+
+/*
+ * Slow
+ *
+ * Sleeps for a second and returns its argument.
+ */
+int Slow(void *arg) {
+    int rc = Sys_Sleep(1);
+    assert(rc == 0);
+    return (int) arg;
+}
+
+int Fast(void *arg) {
+    return (int) arg;
+}
+
+int
+P3_Startup(void *arg)
+{
+    int status, rc, pid, slow, fast, reaped;
+    int pids[MANY];
+    int statuses[MANY];
+
+    rc = Sys_WaitNoHang(&pid, &status);
+    TEST(rc, P1_NO_CHILDREN);
+
+    // Slow runs right away and goes to sleep, Fast only once we block
+    rc = Sys_Spawn("Slow", Slow, (void *) 1, USLOSS_MIN_STACK, 2, &slow);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Fast", Fast, (void *) 2, USLOSS_MIN_STACK, 4, &fast);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_WaitNoHang(&pid, &status);
+    TEST(rc, P2_WOULD_BLOCK);
+    rc = Sys_WaitTimed(100000, &pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(pid, fast);
+    TEST(status, 2);
+    rc = Sys_WaitTimed(100000, &pid, &status);
+    TEST(rc, P2_TIMEOUT);
+    rc = Sys_WaitTimed(-2, &pid, &status);
+    TEST(rc, P2_INVALID_TIMEOUT);
+    rc = Sys_WaitPid(slow, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 1);
+    rc = Sys_WaitPid(slow, &status);
+    TEST(rc, P1_INVALID_PID);
+
+    // waiting for the last one first keeps the others for later
+    for (int i = 0; i < MANY; i++) {
+        rc = Sys_Spawn(MakeName("Fast", i), Fast, (void *) (10 + i), USLOSS_MIN_STACK, 2, &pids[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = Sys_WaitPid(pids[MANY-1], &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 10 + MANY - 1);
+    rc = Sys_WaitMany(pids, statuses, MANY - 1, &reaped);
+    TEST(rc, P1_SUCCESS);
+    TEST(reaped, MANY - 1);
+    for (int i = 0; i < MANY - 1; i++) {
+        TEST(statuses[i], 10 + i);
+    }
+    rc = Sys_WaitMany(pids, statuses, 1, &reaped);
+    TEST(rc, P1_INVALID_PID);
+    TEST(reaped, 0);
+    rc = Sys_Wait(&pid, &status);
+    TEST(rc, P1_NO_CHILDREN);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ClockInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -7,30 +7,67 @@
 #include <phase1.h>
 
 #include "phase2Int.h"
+#include "phase2Ext.h"
 
 
 static int      DiskDriver(void *);
 static void     DiskReadStub(USLOSS_Sysargs *sysargs);
 static void     DiskWriteStub(USLOSS_Sysargs *sysargs);
 static void     DiskSizeStub(USLOSS_Sysargs *sysargs);
+static void     DiskAsyncStub(USLOSS_Sysargs *sysargs);
+
+#define DISK_CONFIG     -1      // request opr for P2DiskConfigure; sectors holds the flags
+#define ASYNC_SLOTS     (2*P1_MAXPROC)  // requests from P2_DiskSubmit not yet polled
+
+static void     WaitReady(int unit);
+static int      Submit(int unit, int opr, int track, int first, int sectors, void *buffer);
 
 typedef struct DiskRequest{
     int first;
     int sectors;
     int track;
     void *buffer;
+    int sid;        // V'd by the driver when the request is complete
+    int owner;      // for P2_DiskSubmit, process unparked instead, otherwise -1
+    int done;       // the driver has completed it
+    int rc;         // result of the request
     USLOSS_DeviceRequest request;
     struct DiskRequest *next;
 }DiskRequest;
 
 typedef struct Disk{
     int pid;
-    int tracks;
+    int tracks;     // tracks available to users, valid once ready is set
+    int ready;      // geometry is known
+    int readySid;   // V'd by the driver once the geometry is known
+    int sid;        // V'd once per queued request, and once more to stop the driver
+    int exitSid;    // V'd by the driver when it has stopped
+    int flags;      // P2_DISK_* options
+    int failAfter;  // sector transfers before one is made to fail, -1 for none
+    int head;       // track the arm is on, -1 if unknown
     DiskRequest *requestQhead;
+    P2_DiskStats stats;
+    // track buffer
+    int bufTrack;   // track held in trackBuf, -1 if none
+    int valid[USLOSS_DISK_TRACK_SIZE];
+    int dirty[USLOSS_DISK_TRACK_SIZE];
+    char trackBuf[USLOSS_DISK_TRACK_SIZE][USLOSS_DISK_SECTOR_SIZE];
+    // write log, allocated while P2_DISK_LOG is set
+    int logStart;   // first track of the log, which runs to the end of the disk
+    int logSectors; // size of the log
+    int logHead;    // next free slot in the log
+    int cleanPos;   // slots before this one have been moved back home
+    int *remap;     // slot in the log holding each user sector, -1 if none
+    int *logOwner;  // user sector held in each slot of the log, -1 if none
+    char cleanBuf[USLOSS_DISK_TRACK_SIZE][USLOSS_DISK_SECTOR_SIZE];
 }Disk;
 
-static Disk disks[2];
-static int requestSem;
+static Disk disks[USLOSS_DISK_UNITS];
+static int waitSids[P1_MAXPROC];   // per-process semaphores for waiting on requests
+static int draining;                // P2DiskDrain has been called
+static int deadline;                // time at which a drain cancels queued requests, -1 for never
+static DiskRequest *async[ASYNC_SLOTS];     // requests from P2_DiskSubmit, NULL if free
+static int asyncGen[ASYNC_SLOTS];           // bumped each time a slot is freed
 
 void enQ(int unit, DiskRequest *request){
     if(disks[unit].requestQhead==NULL){
@@ -45,16 +82,24 @@ void enQ(int unit, DiskRequest *request){
     }
 }
 
+// the process that made the request frees it
 void deQ(int unit){
     if(disks[unit].requestQhead==NULL){
         return;
     }else{
-        DiskRequest *tmp;
-        tmp=disks[unit].requestQhead;
         disks[unit].requestQhead=disks[unit].requestQhead->next;
-        free(tmp);
     }
 }
+
+static int
+Now(void)
+{
+    int rc;
+    int now;
+    rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    return now;
+}
+
 /*
  * P2DiskInit
  *
@@ -65,23 +110,38 @@ P2DiskInit(void)
 {
     int rc;
     // initialize data structures here
-    for(int i=0;i<2;i++){
+    for(int i=0;i<USLOSS_DISK_UNITS;i++){
+        char name[P1_MAXNAME];
         disks[i].requestQhead=NULL;
-        USLOSS_DeviceRequest trackRequest;
-        int *tracks=malloc(sizeof(int));
-        trackRequest.opr=USLOSS_DISK_TRACKS;
-        trackRequest.reg1=(void*) tracks;
-        int rc,status;
-        rc=USLOSS_DeviceOutput(USLOSS_DISK_DEV,i,&trackRequest);
-        if(rc==P1_SUCCESS){
-            rc=P1_WaitDevice(USLOSS_DISK_DEV, i, &status);
-            disks[i].tracks=*tracks;
-        }else{
-            disks[i].tracks=0;
-        }
+        disks[i].tracks=0;
+        disks[i].ready=FALSE;
+        disks[i].flags=0;
+        disks[i].failAfter=-1;
+        disks[i].head=-1;
+        disks[i].bufTrack=-1;
+        disks[i].remap=NULL;
+        disks[i].logOwner=NULL;
+        memset(&disks[i].stats, 0, sizeof(disks[i].stats));
+        snprintf(name, sizeof(name), "Disk%d_Ready", i);
+        rc = P1_SemCreate(name,0,&disks[i].readySid);
+        assert(rc == P1_SUCCESS);
+        snprintf(name, sizeof(name), "Disk%d_Sem", i);
+        rc = P1_SemCreate(name,0,&disks[i].sid);
+        assert(rc == P1_SUCCESS);
+        snprintf(name, sizeof(name), "Disk%d_Exit", i);
+        rc = P1_SemCreate(name,0,&disks[i].exitSid);
+        assert(rc == P1_SUCCESS);
     }
 
-    rc = P1_SemCreate("Request_Sem",0,&requestSem);
+    for(int i=0;i<P1_MAXPROC;i++){
+        waitSids[i]=-1;
+    }
+    for(int i=0;i<ASYNC_SLOTS;i++){
+        async[i]=NULL;
+        asyncGen[i]=0;
+    }
+    draining=FALSE;
+    deadline=-1;
     // install system call stubs here
 
     rc = P2_SetSyscallHandler(SYS_DISKREAD, DiskReadStub);
@@ -90,12 +150,16 @@ P2DiskInit(void)
     assert(rc == P1_SUCCESS);
     rc = P2_SetSyscallHandler(SYS_DISKSIZE, DiskSizeStub);
     assert(rc == P1_SUCCESS);
-
-    // fork the disk drivers here
-    rc = P1_Fork("Disk1_Driver", DiskDriver, (void*) 0, USLOSS_MIN_STACK, 2 , 0, &disks[0].pid);
-    assert(rc == P1_SUCCESS);
-    rc = P1_Fork("Disk2_Driver", DiskDriver, (void*) 1, USLOSS_MIN_STACK, 2 , 0, &disks[1].pid);
+    rc = P2_SetSyscallHandler(SYS_DISKASYNC, DiskAsyncStub);
     assert(rc == P1_SUCCESS);
+
+    // fork the disk drivers here; each one finds out the size of its disk
+    for(int i=0;i<USLOSS_DISK_UNITS;i++){
+        char name[P1_MAXNAME];
+        snprintf(name, sizeof(name), "Disk%d_Driver", i+1);
+        rc = P1_Fork(name, DiskDriver, (void*) i, USLOSS_MIN_STACK, 2 , 0, &disks[i].pid);
+        assert(rc == P1_SUCCESS);
+    }
 }
 
 /*
@@ -106,23 +170,641 @@ P2DiskInit(void)
 
 void 
 P2DiskShutdown(void) 
+{
+    int rc;
+    int elapsed;
+    // P2DiskDrain may already have stopped them
+    rc = P2DiskDrain(-1, &elapsed);
+    assert(rc == P1_SUCCESS || rc == P1_INVALID_STATE);
+}
+
+/*
+ * P2DiskDrain
+ *
+ * Stops the disk drivers. New requests fail with P1_WAIT_ABORTED from now on. Queued
+ * requests are completed until timeout microseconds have passed (never, if timeout is
+ * negative); after that the rest fail with P1_WAIT_ABORTED. Either way the track buffers
+ * are written back before the drivers stop. Returns how long this took in *elapsed, or
+ * P1_INVALID_STATE if the drivers have already been stopped.
+ */
+int
+P2DiskDrain(int timeout, int *elapsed)
+{
+    int rc;
+    int start;
+    int enabled;
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if(elapsed==NULL){
+        return P2_NULL_ADDRESS;
+    }
+    start=Now();
+    enabled=P2DisableInterrupts();
+    if(draining){
+        P2RestoreInterrupts(enabled);
+        return P1_INVALID_STATE;
+    }
+    draining=TRUE;
+    deadline= timeout<0 ? -1 : start+timeout;
+    P2RestoreInterrupts(enabled);
+    // the drivers stop when they are woken with nothing left in their queues
+    for(int i =0;i<USLOSS_DISK_UNITS;i++){
+        rc = P1_V(disks[i].sid);
+        assert(rc == P1_SUCCESS);
+        rc = P1_P(disks[i].exitSid);
+        assert(rc == P1_SUCCESS);
+    }
+    for(int i =0;i<USLOSS_DISK_UNITS;i++){
+        rc=P1_SemFree(disks[i].readySid);
+        rc=P1_SemFree(disks[i].sid);
+        rc=P1_SemFree(disks[i].exitSid);
+    }
+    for(int i=0;i<P1_MAXPROC;i++){
+        if(waitSids[i]!=-1){
+            rc=P1_SemFree(waitSids[i]);
+            waitSids[i]=-1;
+        }
+    }
+    // submitted requests nobody polled
+    for(int i=0;i<ASYNC_SLOTS;i++){
+        free(async[i]);
+        async[i]=NULL;
+    }
+    *elapsed=Now()-start;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2DiskConfigure
+ *
+ * Sets the P2_DISK_* options for a unit. Returns once the driver has applied them.
+ */
+int
+P2DiskConfigure(int unit, int flags)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if(unit<0||unit>=USLOSS_DISK_UNITS){
+        return P1_INVALID_UNIT;
+    }
+    WaitReady(unit);
+    return Submit(unit, DISK_CONFIG, 0, 0, flags, NULL);
+}
+
+/*
+ * P2DiskStats
+ *
+ * Returns the unit's counters.
+ */
+int
+P2DiskStats(int unit, P2_DiskStats *stats)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if(unit<0||unit>=USLOSS_DISK_UNITS){
+        return P1_INVALID_UNIT;
+    }
+    if(stats==NULL){
+        return P2_NULL_ADDRESS;
+    }
+    *stats=disks[unit].stats;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2DiskFailAfter
+ *
+ * Makes the unit fail a sector transfer once, after the next transfers ones.
+ */
+int
+P2DiskFailAfter(int unit, int transfers)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if(unit<0||unit>=USLOSS_DISK_UNITS){
+        return P1_INVALID_UNIT;
+    }
+    int enabled=P2DisableInterrupts();
+    disks[unit].failAfter= transfers<0 ? -1 : transfers;
+    P2RestoreInterrupts(enabled);
+    return P1_SUCCESS;
+}
+
+/*
+ * WaitReady
+ *
+ * Blocks until the unit's driver has found out the size of the disk.
+ */
+static void
+WaitReady(int unit)
+{
+    int rc;
+    if(!disks[unit].ready){
+        rc = P1_P(disks[unit].readySid);
+        assert(rc == P1_SUCCESS);
+        // let the next waiter through
+        rc = P1_V(disks[unit].readySid);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+/*
+ * DiskOp
+ *
+ * Issues a single operation to the disk and waits for it to finish.
+ */
+static int
+DiskOp(int unit, int opr, void *reg1, void *reg2)
 {
     int rc;
     int status;
-    rc=P1_SemFree(requestSem);
-    for(int i =0;i<2;i++){
-        DiskRequest *tmp;
-        tmp = disks[i].requestQhead;
-        while(disks[i].requestQhead!=NULL){
-            tmp=disks[i].requestQhead->next;
-            free(disks[i].requestQhead);
-            disks[i].requestQhead=tmp;
+    USLOSS_DeviceRequest request;
+    request.opr=opr;
+    request.reg1=reg1;
+    request.reg2=reg2;
+    int type = opr==USLOSS_DISK_SEEK ? P2_TRACE_DISK_SEEK : P2_TRACE_DISK_XFER;
+    P2_TRACE(type, 'B', (int) reg1);
+    rc=USLOSS_DeviceOutput(USLOSS_DISK_DEV,unit,&request);
+    if(rc!=USLOSS_DEV_OK){
+        P2_TRACE(type, 'E', (int) reg1);
+        return rc;
+    }
+    rc=P1_WaitDevice(USLOSS_DISK_DEV, unit, &status);
+    P2_TRACE(type, 'E', (int) reg1);
+    if(rc!=P1_SUCCESS){
+        return rc;
+    }
+    return status==USLOSS_DEV_ERROR ? USLOSS_DEV_ERROR : USLOSS_DEV_OK;
+}
+
+/*
+ * Transfer
+ *
+ * Reads or writes one sector, seeking first only if the arm is on another track. Returns
+ * P2_DEVICE_ERROR if the disk fails either operation.
+ */
+static int
+Transfer(int unit, int opr, int track, int sector, void *buffer)
+{
+    int rc;
+    if(disks[unit].head!=track){
+        rc=DiskOp(unit, USLOSS_DISK_SEEK, (void *) track, NULL);
+        disks[unit].head= rc==USLOSS_DEV_OK ? track : -1;
+        if(rc!=USLOSS_DEV_OK){
+            return P2_DEVICE_ERROR;
+        }
+    }
+    if(disks[unit].failAfter==0){
+        // injected by P2DiskFailAfter
+        disks[unit].failAfter=-1;
+        return P2_DEVICE_ERROR;
+    }
+    if(disks[unit].failAfter>0){
+        disks[unit].failAfter--;
+    }
+    rc=DiskOp(unit, opr, (void *) sector, buffer);
+    return rc==USLOSS_DEV_OK ? P1_SUCCESS : P2_DEVICE_ERROR;
+}
+
+/*
+ * FlushTrack
+ *
+ * Writes the dirty sectors of the track buffer back to the disk. Sectors that fail to
+ * write stay dirty.
+ */
+static int
+FlushTrack(int unit)
+{
+    Disk *disk=&disks[unit];
+    int result=P1_SUCCESS;
+    if(disk->bufTrack<0){
+        return P1_SUCCESS;
+    }
+    for(int i=0;i<USLOSS_DISK_TRACK_SIZE;i++){
+        if(disk->dirty[i]){
+            int rc=Transfer(unit, USLOSS_DISK_WRITE, disk->bufTrack, i, disk->trackBuf[i]);
+            if(rc==P1_SUCCESS){
+                disk->dirty[i]=0;
+            }else{
+                result=rc;
+            }
+        }
+    }
+    return result;
+}
+
+/*
+ * LoadTrack
+ *
+ * Makes the track buffer hold the given track (-1 for none), writing back what it held
+ * before. Sectors are read from the disk only when first read, so a track that is only
+ * written never has to be read. If the write back fails the buffer keeps its track, so
+ * the dirty sectors are not lost.
+ */
+static int
+LoadTrack(int unit, int track)
+{
+    Disk *disk=&disks[unit];
+    int rc;
+    if(disk->bufTrack==track){
+        return P1_SUCCESS;
+    }
+    rc=FlushTrack(unit);
+    if(rc!=P1_SUCCESS){
+        return rc;
+    }
+    disk->bufTrack=track;
+    for(int i=0;i<USLOSS_DISK_TRACK_SIZE;i++){
+        disk->valid[i]=0;
+        disk->dirty[i]=0;
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * BufferedTransfer
+ *
+ * Reads or writes one sector through the track buffer. Reading a sector that is not in
+ * the buffer reads every missing sector of the track, so later reads of the track need
+ * no disk operations at all. Sectors that fail to read stay missing.
+ */
+static int
+BufferedTransfer(int unit, int opr, int track, int sector, void *buffer)
+{
+    Disk *disk=&disks[unit];
+    int rc=LoadTrack(unit, track);
+    if(rc!=P1_SUCCESS){
+        return rc;
+    }
+    if(opr==USLOSS_DISK_WRITE){
+        memcpy(disk->trackBuf[sector], buffer, USLOSS_DISK_SECTOR_SIZE);
+        disk->valid[sector]=1;
+        disk->dirty[sector]=1;
+        return P1_SUCCESS;
+    }
+    if(!disk->valid[sector]){
+        for(int i=0;i<USLOSS_DISK_TRACK_SIZE;i++){
+            if(!disk->valid[i]){
+                rc=Transfer(unit, USLOSS_DISK_READ, track, i, disk->trackBuf[i]);
+                disk->valid[i]= rc==P1_SUCCESS;
+            }
+        }
+        if(!disk->valid[sector]){
+            return P2_DEVICE_ERROR;
+        }
+    }
+    memcpy(buffer, disk->trackBuf[sector], USLOSS_DISK_SECTOR_SIZE);
+    return P1_SUCCESS;
+}
+
+/*
+ * CachedTransfer
+ *
+ * Reads or writes one sector, through the track buffer if it is on.
+ */
+static int
+CachedTransfer(int unit, int opr, int track, int sector, void *buffer)
+{
+    if(disks[unit].flags&P2_DISK_TRACKBUF){
+        return BufferedTransfer(unit, opr, track, sector, buffer);
+    }
+    return Transfer(unit, opr, track, sector, buffer);
+}
+
+/*
+ * CleanStep
+ *
+ * Moves the sectors in the oldest track of the log back to their home locations, reading
+ * the log track once and visiting the homes in order. Returns FALSE, and empties the log,
+ * once there is nothing left to move. Also returns FALSE, with the error in *rc, if a
+ * transfer fails; sectors that could not be moved stay in the log.
+ */
+static int
+CleanStep(int unit, int *rc)
+{
+    Disk *disk=&disks[unit];
+    int slots[USLOSS_DISK_TRACK_SIZE];
+    int moved[USLOSS_DISK_TRACK_SIZE];
+    int count=0;
+    *rc=P1_SUCCESS;
+    if(disk->cleanPos>=disk->logHead){
+        disk->logHead=0;
+        disk->cleanPos=0;
+        return FALSE;
+    }
+    int track=disk->logStart+disk->cleanPos/USLOSS_DISK_TRACK_SIZE;
+    int end=(track-disk->logStart+1)*USLOSS_DISK_TRACK_SIZE;
+    if(end>disk->logHead){
+        end=disk->logHead;
+    }
+    // slots of this track still in use, sorted by home
+    for(int slot=disk->cleanPos;slot<end;slot++){
+        if(disk->logOwner[slot]!=-1){
+            int i=count++;
+            while(i>0&&disk->logOwner[slots[i-1]]>disk->logOwner[slot]){
+                slots[i]=slots[i-1];
+                i--;
+            }
+            slots[i]=slot;
+        }
+    }
+    for(int i=0;i<count;i++){
+        int sector=slots[i]%USLOSS_DISK_TRACK_SIZE;
+        if(disk->bufTrack==track){
+            moved[i]=BufferedTransfer(unit, USLOSS_DISK_READ, track, sector, disk->cleanBuf[i]);
+        }else{
+            // the disk is up to date, and going around the track buffer keeps it
+            // from bouncing between the log and the homes
+            moved[i]=Transfer(unit, USLOSS_DISK_READ, track, sector, disk->cleanBuf[i]);
+        }
+    }
+    for(int i=0;i<count;i++){
+        int home=disk->logOwner[slots[i]];
+        if(moved[i]==P1_SUCCESS){
+            moved[i]=CachedTransfer(unit, USLOSS_DISK_WRITE, home/USLOSS_DISK_TRACK_SIZE,
+                                    home%USLOSS_DISK_TRACK_SIZE, disk->cleanBuf[i]);
+        }
+        if(moved[i]!=P1_SUCCESS){
+            *rc=moved[i];
+            continue;
+        }
+        disk->logOwner[slots[i]]=-1;
+        disk->remap[home]=-1;
+    }
+    if(*rc!=P1_SUCCESS){
+        // try the track again next time
+        return FALSE;
+    }
+    disk->cleanPos=end;
+    return TRUE;
+}
+
+/*
+ * StartLog
+ *
+ * Sets aside the last eighth of the disk (at least one track) for the write log. Fails
+ * with P1_INVALID_STATE if the disk is too small, or if anything has been written to
+ * that part of it, since the log would overwrite it.
+ */
+static int
+StartLog(int unit)
+{
+    Disk *disk=&disks[unit];
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    int logTracks=disk->tracks/8;
+    int rc;
+    if(logTracks==0){
+        logTracks=1;
+    }
+    if(disk->tracks<=logTracks){
+        return P1_INVALID_STATE;
+    }
+    for(int track=disk->tracks-logTracks;track<disk->tracks;track++){
+        for(int i=0;i<USLOSS_DISK_TRACK_SIZE;i++){
+            rc=CachedTransfer(unit, USLOSS_DISK_READ, track, i, sector);
+            if(rc!=P1_SUCCESS){
+                return rc;
+            }
+            for(int j=0;j<USLOSS_DISK_SECTOR_SIZE;j++){
+                if(sector[j]!=0){
+                    return P1_INVALID_STATE;
+                }
+            }
+        }
+    }
+    disk->logStart=disk->tracks-logTracks;
+    disk->logSectors=logTracks*USLOSS_DISK_TRACK_SIZE;
+    disk->logHead=0;
+    disk->cleanPos=0;
+    disk->remap=malloc(disk->logStart*USLOSS_DISK_TRACK_SIZE*sizeof(int));
+    disk->logOwner=malloc(disk->logSectors*sizeof(int));
+    for(int i=0;i<disk->logStart*USLOSS_DISK_TRACK_SIZE;i++){
+        disk->remap[i]=-1;
+    }
+    for(int i=0;i<disk->logSectors;i++){
+        disk->logOwner[i]=-1;
+    }
+    disk->tracks=disk->logStart;
+    return P1_SUCCESS;
+}
+
+/*
+ * StopLog
+ *
+ * Moves everything in the log back home and gives the log's tracks back to users,
+ * cleared so the log can be started again. The log stays on if anything in it can't be
+ * moved.
+ */
+static int
+StopLog(int unit)
+{
+    Disk *disk=&disks[unit];
+    char zero[USLOSS_DISK_SECTOR_SIZE];
+    int rc;
+    if(disk->remap==NULL){
+        return P1_SUCCESS;
+    }
+    while(CleanStep(unit, &rc)){
+    }
+    if(rc!=P1_SUCCESS){
+        return rc;
+    }
+    memset(zero, 0, sizeof(zero));
+    for(int slot=0;slot<disk->logSectors;slot++){
+        rc=CachedTransfer(unit, USLOSS_DISK_WRITE, disk->logStart+slot/USLOSS_DISK_TRACK_SIZE,
+                          slot%USLOSS_DISK_TRACK_SIZE, zero);
+        if(rc!=P1_SUCCESS){
+            return rc;
+        }
+    }
+    free(disk->remap);
+    free(disk->logOwner);
+    disk->remap=NULL;
+    disk->logOwner=NULL;
+    disk->tracks=disk->logStart+disk->logSectors/USLOSS_DISK_TRACK_SIZE;
+    return P1_SUCCESS;
+}
+
+/*
+ * LogTransfer
+ *
+ * Reads or writes one user sector. While the log is on, writes are appended to the log
+ * instead of going to the sector's home location, so scattered writes become sequential,
+ * and reads of a sector that is in the log are served from there.
+ */
+static int
+LogTransfer(int unit, int opr, int track, int sector, void *buffer)
+{
+    Disk *disk=&disks[unit];
+    int home=track*USLOSS_DISK_TRACK_SIZE+sector;
+    int slot;
+    int rc;
+    if(disk->remap==NULL){
+        return CachedTransfer(unit, opr, track, sector, buffer);
+    }
+    if(opr==USLOSS_DISK_READ){
+        slot=disk->remap[home];
+        if(slot==-1){
+            return CachedTransfer(unit, opr, track, sector, buffer);
+        }
+        return CachedTransfer(unit, opr, disk->logStart+slot/USLOSS_DISK_TRACK_SIZE,
+                              slot%USLOSS_DISK_TRACK_SIZE, buffer);
+    }
+    if(disk->logHead==disk->logSectors){
+        // log is full
+        while(CleanStep(unit, &rc)){
+        }
+        if(rc!=P1_SUCCESS){
+            return rc;
+        }
+    }
+    slot=disk->logHead;
+    rc=CachedTransfer(unit, opr, disk->logStart+slot/USLOSS_DISK_TRACK_SIZE,
+                      slot%USLOSS_DISK_TRACK_SIZE, buffer);
+    if(rc!=P1_SUCCESS){
+        // the sector's old copy is still the current one
+        return rc;
+    }
+    disk->logHead++;
+    if(disk->remap[home]!=-1){
+        disk->logOwner[disk->remap[home]]=-1;
+    }
+    disk->remap[home]=slot;
+    disk->logOwner[slot]=home;
+    return P1_SUCCESS;
+}
+
+/*
+ * CanTransferDirect
+ *
+ * Returns whether a whole track can go straight between the disk and the caller's
+ * buffer. It can't if part of the track to be read is only in the log or in the track
+ * buffer.
+ */
+static int
+CanTransferDirect(int unit, int opr, int track)
+{
+    Disk *disk=&disks[unit];
+    int home=track*USLOSS_DISK_TRACK_SIZE;
+    if(!(disk->flags&P2_DISK_DIRECT)){
+        return FALSE;
+    }
+    if(opr==USLOSS_DISK_READ){
+        if(disk->bufTrack==track){
+            return FALSE;
+        }
+        for(int i=0;disk->remap!=NULL&&i<USLOSS_DISK_TRACK_SIZE;i++){
+            if(disk->remap[home+i]!=-1){
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * DirectTransfer
+ *
+ * Reads or writes a whole track straight between the disk and the caller's buffer,
+ * skipping the log and the track buffer. Stops at the first sector that fails.
+ */
+static int
+DirectTransfer(int unit, int opr, int track, void *buffer)
+{
+    Disk *disk=&disks[unit];
+    int home=track*USLOSS_DISK_TRACK_SIZE;
+    int rc=P1_SUCCESS;
+    int done=0;
+    while(done<USLOSS_DISK_TRACK_SIZE&&rc==P1_SUCCESS){
+        rc=Transfer(unit, opr, track, done, buffer+USLOSS_DISK_SECTOR_SIZE*done);
+        if(rc==P1_SUCCESS){
+            done++;
         }
     }
-    rc=USLOSS_DeviceInput(USLOSS_DISK_DEV, 0,&status);
-    rc=P1_WakeupDevice(USLOSS_DISK_DEV, 0,status,TRUE);
-    rc=USLOSS_DeviceInput(USLOSS_DISK_DEV, 1,&status);
-    rc=P1_WakeupDevice(USLOSS_DISK_DEV, 1,status,TRUE);
+    if(opr==USLOSS_DISK_WRITE){
+        // whatever the buffer and the log held for the sectors written is now stale; the
+        // rest of the track still has to come from them if the write failed partway
+        if(disk->bufTrack==track){
+            for(int i=0;i<done;i++){
+                disk->valid[i]=0;
+                disk->dirty[i]=0;
+            }
+        }
+        for(int i=0;disk->remap!=NULL&&i<done;i++){
+            if(disk->remap[home+i]!=-1){
+                disk->logOwner[disk->remap[home+i]]=-1;
+                disk->remap[home+i]=-1;
+            }
+        }
+    }
+    if(rc==P1_SUCCESS){
+        disk->stats.directTracks++;
+    }
+    return rc;
+}
+
+/*
+ * ApplyConfig
+ *
+ * Switches the unit to the given P2_DISK_* options, writing back whatever the options
+ * being turned off were holding. The options stay as they were if that fails.
+ */
+static int
+ApplyConfig(int unit, int flags)
+{
+    Disk *disk=&disks[unit];
+    int rc;
+    if((flags&P2_DISK_LOG)&&disk->remap==NULL){
+        rc=StartLog(unit);
+        if(rc!=P1_SUCCESS){
+            return rc;
+        }
+    }
+    if(!(flags&P2_DISK_LOG)){
+        rc=StopLog(unit);
+        if(rc!=P1_SUCCESS){
+            return rc;
+        }
+    }
+    if(!(flags&P2_DISK_TRACKBUF)){
+        rc=LoadTrack(unit, -1);
+        if(rc!=P1_SUCCESS){
+            return rc;
+        }
+    }
+    disk->flags=flags;
+    return P1_SUCCESS;
+}
+
+/*
+ * Complete
+ *
+ * Removes the request at the head of the queue and wakes the process waiting for it.
+ */
+static void
+Complete(int unit, DiskRequest *request, int result)
+{
+    int rc;
+    int enabled=P2DisableInterrupts();
+    deQ(unit);
+    P2RestoreInterrupts(enabled);
+    // once done is set an async owner may free the request, so nothing is read after
+    int owner=request->owner;
+    int sid=request->sid;
+    request->rc=result;
+    request->done=TRUE;
+    P2_TRACE(P2_TRACE_DISK_DONE, 'i', result);
+    if(owner!=-1){
+        // the owner finds out with P2_DiskPoll
+        P2ProcUnpark(owner);
+        return;
+    }
+    rc = P1_V(sid);
+    assert(rc == P1_SUCCESS);
 }
 
 /*
@@ -135,68 +817,89 @@ static int
 DiskDriver(void *arg) 
 {
     int unit = (int) arg;
+    int rc;
     // repeat
     //   wait for next request
     //   while request isn't complete
-    //          send appropriate operation to disk (USLOSS_DeviceOutput)
+    //          send appropriate operation to disk, or go through the log and track buffer
     //          wait for operation to finish (P1_WaitDevice)
     //          handle errors
     //   update the request status and wake the waiting process
     // until P2DiskShutdown has been called
+    int tracks;
+    rc=DiskOp(unit, USLOSS_DISK_TRACKS, (void *) &tracks, NULL);
+    disks[unit].tracks= rc==USLOSS_DEV_OK ? tracks : 0;
+    disks[unit].ready=TRUE;
+    rc = P1_V(disks[unit].readySid);
+    assert(rc == P1_SUCCESS);
     while(1){
-        int rc;
-        int status;
-        rc = P1_WaitDevice(USLOSS_DISK_DEV, unit, &status);
-        if (rc == P1_WAIT_ABORTED) {
+        Disk *disk=&disks[unit];
+        // clean the log while there is nothing else to do, once it is half full
+        while(disk->remap!=NULL&&disk->logHead*2>=disk->logSectors
+              &&disk->requestQhead==NULL&&CleanStep(unit, &rc)){
+        }
+        rc = P1_P(disk->sid);
+        assert(rc == P1_SUCCESS);
+        if(disk->requestQhead==NULL){
+            // woken by P2DiskShutdown
             break;
         }
-        if(disks[unit].requestQhead!=NULL){
-            DiskRequest *tmp=disks[unit].requestQhead;
-            int trackIndex=tmp->track;
-            int sectorIndex=tmp->first;
-            USLOSS_DeviceRequest seekRequest;
-            seekRequest.opr=USLOSS_DISK_SEEK;
-            seekRequest.reg1=(void*) trackIndex;
-            rc=USLOSS_DeviceOutput(USLOSS_DISK_DEV,unit,&seekRequest);
-            rc=P1_WaitDevice(USLOSS_DISK_DEV, unit, &status);
-            for (int i = 0; i < tmp->sectors; i++){
-                sectorIndex++;
-                if(sectorIndex>=USLOSS_DISK_TRACK_SIZE){
-                    trackIndex++;
-                    seekRequest.reg1=(void*) trackIndex;
-                    rc=USLOSS_DeviceOutput(USLOSS_DISK_DEV,unit,&seekRequest);
-                    rc=P1_WaitDevice(USLOSS_DISK_DEV, unit, &status);
-                    sectorIndex=sectorIndex%USLOSS_DISK_TRACK_SIZE;
-                }
-                tmp->request.reg1 =(void *) sectorIndex;
-                tmp->request.reg2 = tmp->buffer+USLOSS_DISK_SECTOR_SIZE*i;
-                rc=USLOSS_DeviceOutput(USLOSS_DISK_DEV,unit,&tmp->request);
-                rc=P1_WaitDevice(USLOSS_DISK_DEV, unit, &status);
+        DiskRequest *tmp=disk->requestQhead;
+        if(tmp->request.opr==DISK_CONFIG){
+            Complete(unit, tmp, ApplyConfig(unit, tmp->sectors));
+            continue;
+        }
+        if(draining&&deadline>=0&&Now()>=deadline){
+            Complete(unit, tmp, P1_WAIT_ABORTED);
+            continue;
+        }
+        if(tmp->track+(tmp->first+tmp->sectors-1)/USLOSS_DISK_TRACK_SIZE>=disk->tracks){
+            // validated before the log took the end of the disk
+            Complete(unit, tmp, P2_INVALID_SECTORS);
+            continue;
+        }
+        int trackIndex=tmp->track;
+        int sectorIndex=tmp->first;
+        int result=P1_SUCCESS;
+        disk->stats.requests++;
+        // the request fails at the first sector the disk can't transfer
+        for (int i = 0; i < tmp->sectors && result==P1_SUCCESS; ){
+            if(sectorIndex>=USLOSS_DISK_TRACK_SIZE){
+                trackIndex++;
+                sectorIndex=0;
             }
-            deQ(unit);
-            rc = P1_V(requestSem);
+            if(sectorIndex==0&&tmp->sectors-i>=USLOSS_DISK_TRACK_SIZE
+               &&CanTransferDirect(unit, tmp->request.opr, trackIndex)){
+                result=DirectTransfer(unit, tmp->request.opr, trackIndex,
+                                      tmp->buffer+USLOSS_DISK_SECTOR_SIZE*i);
+                i+=USLOSS_DISK_TRACK_SIZE;
+                sectorIndex+=USLOSS_DISK_TRACK_SIZE;
+                continue;
+            }
+            result=LogTransfer(unit, tmp->request.opr, trackIndex, sectorIndex,
+                               tmp->buffer+USLOSS_DISK_SECTOR_SIZE*i);
+            sectorIndex++;
+            i++;
         }
-        
+        Complete(unit, tmp, result);
     }
+    rc = ApplyConfig(unit, 0);
+    rc = P1_V(disks[unit].exitSid);
     return P1_SUCCESS;
 }
 
 /*
- * P2_DiskRead
+ * Validate
  *
- * Reads the specified number of sectors from the disk starting at the specified track and sector.
+ * Checks the arguments of a read or write.
  */
-int 
-P2_DiskRead(int unit, int track, int first, int sectors, void *buffer) 
+static int
+Validate(int unit, int track, int first, int sectors, void *buffer)
 {
-    int rc;
-    int status;
-    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
-        USLOSS_IllegalInstruction();
-    }
-    if(unit!=0&&unit!=1){
+    if(unit<0||unit>=USLOSS_DISK_UNITS){
         return P1_INVALID_UNIT;
     }
+    WaitReady(unit);
     if(track<0||track>=disks[unit].tracks){
         return P2_INVALID_TRACK;
     }
@@ -209,73 +912,242 @@ P2_DiskRead(int unit, int track, int first, int sectors, void *buffer)
     if(buffer==NULL){
         return P2_NULL_ADDRESS;
     }
-    // give request to the proper device driver
+    return P1_SUCCESS;
+}
+
+/*
+ * Account
+ *
+ * Adds a completed read or write to the caller's statistics.
+ */
+static void
+Account(int opr, int sectors)
+{
+    P2_ProcStats *stats=P2ProcStatsFor(P1_GetPid());
+    if(opr==USLOSS_DISK_READ){
+        stats->sectorsRead+=sectors;
+    }else{
+        stats->sectorsWritten+=sectors;
+    }
+}
+
+/*
+ * DiskIO
+ *
+ * Validates a read or write and gives it to the unit's driver.
+ */
+static int
+DiskIO(int opr, int unit, int track, int first, int sectors, void *buffer)
+{
+    int rc=Validate(unit, track, first, sectors, buffer);
+    if(rc!=P1_SUCCESS){
+        return rc;
+    }
+    int start=Now();
+    rc=Submit(unit, opr, track, first, sectors, buffer);
+    P2ProcStatsFor(P1_GetPid())->diskWait+=Now()-start;
+    if(rc==P1_SUCCESS){
+        Account(opr, sectors);
+    }
+    return rc;
+}
+
+/*
+ * NewRequest
+ *
+ * Allocates a request. Whoever made it frees it once it is complete.
+ */
+static DiskRequest *
+NewRequest(int opr, int track, int first, int sectors, void *buffer)
+{
     DiskRequest *diskRequest=malloc(sizeof(DiskRequest));
-    diskRequest->request.opr = USLOSS_DISK_READ;
+    diskRequest->request.opr = opr;
     diskRequest->first=first;
     diskRequest->track=track;
     diskRequest->sectors=sectors;
     diskRequest->buffer=buffer;
+    diskRequest->sid=-1;
+    diskRequest->owner=-1;
+    diskRequest->done=FALSE;
     diskRequest->next=NULL;
+    return diskRequest;
+}
+
+/*
+ * Queue
+ *
+ * Gives a request to the unit's driver, unless the disks are being drained.
+ */
+static int
+Queue(int unit, DiskRequest *diskRequest)
+{
+    int rc;
+    int enabled=P2DisableInterrupts();
+    if(draining){
+        P2RestoreInterrupts(enabled);
+        return P1_WAIT_ABORTED;
+    }
     enQ(unit,diskRequest);
-    rc=USLOSS_DeviceInput(USLOSS_DISK_DEV, unit,&status);
-    rc=P1_WakeupDevice(USLOSS_DISK_DEV, unit,status,FALSE);
-    // wait until device driver completes the request
-    rc = P1_P(requestSem);
+    P2_TRACE(P2_TRACE_DISK_QUEUE, 'i', diskRequest->track);
+    rc=P1_V(disks[unit].sid);
+    P2RestoreInterrupts(enabled);
     return P1_SUCCESS;
 }
 
-int 
-P2_DiskWrite(int unit, int track, int first, int sectors, void *buffer) 
+/*
+ * Submit
+ *
+ * Gives a request to the unit's driver and waits for it to complete.
+ */
+static int
+Submit(int unit, int opr, int track, int first, int sectors, void *buffer)
 {
     int rc;
-    int status;
+    int pid;
+    if(draining){
+        return P1_WAIT_ABORTED;
+    }
+    pid=P1_GetPid();
+    if(waitSids[pid]==-1){
+        char name[P1_MAXNAME];
+        snprintf(name, sizeof(name), "Disk_Wait_%d", pid);
+        rc = P1_SemCreate(name,0,&waitSids[pid]);
+        assert(rc == P1_SUCCESS);
+    }
+    // give request to the proper device driver
+    DiskRequest *diskRequest=NewRequest(opr, track, first, sectors, buffer);
+    diskRequest->sid=waitSids[pid];
+    rc=Queue(unit, diskRequest);
+    if(rc!=P1_SUCCESS){
+        free(diskRequest);
+        return rc;
+    }
+    // wait until device driver completes the request
+    rc = P1_P(diskRequest->sid);
+    assert(rc == P1_SUCCESS);
+    rc = diskRequest->rc;
+    free(diskRequest);
+    return rc;
+}
+
+/*
+ * P2_DiskSubmit
+ *
+ * Starts a read or write without waiting for it, and returns a ticket for it.
+ */
+int
+P2_DiskSubmit(P2_DiskIO *io, int *ticket)
+{
+    int rc;
+    int enabled;
+    int slot;
     if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
         USLOSS_IllegalInstruction();
     }
-    if(unit!=0&&unit!=1){
-        return P1_INVALID_UNIT;
+    if(io==NULL||ticket==NULL){
+        return P2_NULL_ADDRESS;
     }
-    if(track<0||track>=disks[unit].tracks){
-        return P2_INVALID_TRACK;
+    rc=Validate(io->unit, io->track, io->first, io->sectors, io->buffer);
+    if(rc!=P1_SUCCESS){
+        return rc;
     }
-    if(first<0||first>=USLOSS_DISK_TRACK_SIZE){
-        return P2_INVALID_FIRST;
+    if(draining){
+        return P1_WAIT_ABORTED;
     }
-    if(sectors<0||(first+sectors)/USLOSS_DISK_TRACK_SIZE+track>=disks[unit].tracks){
-        return P2_INVALID_SECTORS;
+    DiskRequest *diskRequest=NewRequest(io->write ? USLOSS_DISK_WRITE : USLOSS_DISK_READ,
+                                        io->track, io->first, io->sectors, io->buffer);
+    diskRequest->owner=P1_GetPid();
+    enabled=P2DisableInterrupts();
+    for(slot=0;slot<ASYNC_SLOTS&&async[slot]!=NULL;slot++){
     }
-    if(buffer==NULL){
+    if(slot<ASYNC_SLOTS){
+        async[slot]=diskRequest;
+    }
+    P2RestoreInterrupts(enabled);
+    if(slot==ASYNC_SLOTS){
+        free(diskRequest);
+        return P2_WOULD_BLOCK;
+    }
+    *ticket=asyncGen[slot]*ASYNC_SLOTS+slot;
+    rc=Queue(io->unit, diskRequest);
+    if(rc!=P1_SUCCESS){
+        async[slot]=NULL;
+        asyncGen[slot]++;
+        free(diskRequest);
+    }
+    return rc;
+}
+
+/*
+ * P2_DiskPoll
+ *
+ * Returns the result of a request from P2_DiskSubmit once it has completed, and
+ * forgets the ticket. Returns P2_WOULD_BLOCK if it hasn't completed yet.
+ */
+int
+P2_DiskPoll(int ticket, int *result)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if(result==NULL){
         return P2_NULL_ADDRESS;
     }
-    // give request to the proper device driver
-    DiskRequest *diskRequest=malloc(sizeof(DiskRequest));
-    diskRequest->request.opr = USLOSS_DISK_WRITE;
-    diskRequest->first=first;
-    diskRequest->track=track;
-    diskRequest->sectors=sectors;
-    diskRequest->buffer=buffer;
-    diskRequest->next=NULL;
-    enQ(unit,diskRequest);
-    rc=USLOSS_DeviceInput(USLOSS_DISK_DEV, unit,&status);
-    rc=P1_WakeupDevice(USLOSS_DISK_DEV, unit,status,FALSE);
-    // wait until device driver completes the request
-    rc = P1_P(requestSem);
+    int slot=ticket%ASYNC_SLOTS;
+    if(ticket<0||async[slot]==NULL||asyncGen[slot]!=ticket/ASYNC_SLOTS
+       ||async[slot]->owner!=P1_GetPid()){
+        return P2_INVALID_TICKET;
+    }
+    DiskRequest *diskRequest=async[slot];
+    if(!diskRequest->done){
+        return P2_WOULD_BLOCK;
+    }
+    *result=diskRequest->rc;
+    if(*result==P1_SUCCESS){
+        Account(diskRequest->request.opr, diskRequest->sectors);
+    }
+    async[slot]=NULL;
+    asyncGen[slot]++;
+    free(diskRequest);
     return P1_SUCCESS;
 }
 
+/*
+ * P2_DiskRead
+ *
+ * Reads the specified number of sectors from the disk starting at the specified track and sector.
+ */
+int 
+P2_DiskRead(int unit, int track, int first, int sectors, void *buffer) 
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    return DiskIO(USLOSS_DISK_READ, unit, track, first, sectors, buffer);
+}
+
+int 
+P2_DiskWrite(int unit, int track, int first, int sectors, void *buffer) 
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    return DiskIO(USLOSS_DISK_WRITE, unit, track, first, sectors, buffer);
+}
+
 int 
 P2_DiskSize(int unit, int *sector, int *track,int *disk) 
 {
     if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
         USLOSS_IllegalInstruction();
     }
-    if(unit!=0&&unit!=1){
+    if(unit<0||unit>=USLOSS_DISK_UNITS){
         return P1_INVALID_UNIT;
     }
     if(sector==NULL||track==NULL||disk==NULL){
         return P2_NULL_ADDRESS;
     }
+    WaitReady(unit);
     *sector=USLOSS_DISK_SECTOR_SIZE;
     *track=USLOSS_DISK_TRACK_SIZE;
     *disk=disks[unit].tracks;
@@ -332,3 +1204,27 @@ DiskSizeStub(USLOSS_Sysargs *sysargs)
     sysargs->arg4 =(void*) rc;
 }
 
+/*
+ * DiskAsyncStub
+ *
+ * Stub for Sys_DiskSubmit and Sys_DiskPoll, which are told apart by arg5.
+ */
+static void
+DiskAsyncStub(USLOSS_Sysargs *sysargs)
+{
+    int rc;
+    int out=0;
+    switch ((int) sysargs->arg5) {
+        case P2_DISK_SUBMIT:
+            rc = P2_DiskSubmit((P2_DiskIO *) sysargs->arg1, &out);
+            break;
+        case P2_DISK_POLL:
+            rc = P2_DiskPoll((int) sysargs->arg1, &out);
+            break;
+        default:
+            rc = P2_INVALID_FLAGS;
+            break;
+    }
+    sysargs->arg2 = (void *) out;
+    sysargs->arg4 = (void *) rc;
+}
@@ -0,0 +1,115 @@
+/*
+ * bench_direct.c
+ *
+ * Times bulk whole-track writes and reads through the track buffer, first without
+ * P2_DISK_DIRECT and then with it, and checks that the data and the direct-transfer
+ * counter come out right both times.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+#define TRACKS  8
+#define ROUNDS  4
+
+static char buffer[TRACKS * USLOSS_DISK_TRACK_SIZE][USLOSS_DISK_SECTOR_SIZE];
+static int elapsed;
+
+/*
+ * Bulk
+ *
+ * Writes and reads back the whole test area ROUNDS times, one request each.
+ */
+int Bulk(void *arg) {
+    int rc, start, finish;
+
+    Sys_GetTimeOfDay(&start);
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < TRACKS * USLOSS_DISK_TRACK_SIZE; i++) {
+            snprintf(buffer[i], USLOSS_DISK_SECTOR_SIZE, "round %d sector %d", round, i);
+        }
+        rc = Sys_DiskWrite(buffer, 0, 0, TRACKS * USLOSS_DISK_TRACK_SIZE, 0);
+        TEST(rc, P1_SUCCESS);
+        memset(buffer, 0, sizeof(buffer));
+        rc = Sys_DiskRead(buffer, 0, 0, TRACKS * USLOSS_DISK_TRACK_SIZE, 0);
+        TEST(rc, P1_SUCCESS);
+        for (int i = 0; i < TRACKS * USLOSS_DISK_TRACK_SIZE; i++) {
+            char expected[USLOSS_DISK_SECTOR_SIZE];
+            snprintf(expected, sizeof(expected), "round %d sector %d", round, i);
+            TEST(strcmp(buffer[i], expected), 0);
+        }
+    }
+    Sys_GetTimeOfDay(&finish);
+    elapsed = finish - start;
+    return 0;
+}
+
+static int
+Run(int flags)
+{
+    int rc, pid, waitPid, status;
+
+    rc = P2DiskConfigure(0, flags);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Spawn("Bulk", Bulk, NULL, 4*USLOSS_MIN_STACK, 3, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(waitPid, pid);
+    TEST(status, 0);
+    return elapsed;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, buffered, direct;
+    P2_DiskStats stats;
+
+    P2ClockInit();
+    P2DiskInit();
+
+    buffered = Run(P2_DISK_TRACKBUF);
+    rc = P2DiskStats(0, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.directTracks, 0);
+
+    direct = Run(P2_DISK_TRACKBUF | P2_DISK_DIRECT);
+    rc = P2DiskStats(0, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.directTracks, 2 * ROUNDS * TRACKS);
+
+    USLOSS_Console("%d tracks x %d rounds: %d us through the track buffer, %d us direct.\n",
+                   TRACKS, ROUNDS, buffered, direct);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, TRACKS + 2);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
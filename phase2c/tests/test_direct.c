@@ -0,0 +1,98 @@
+/*
+ * test_direct.c
+ *
+ * Tests a whole-track P2_DISK_DIRECT write that fails partway through the track. The
+ * sectors it wrote read back as written, and the others keep what the track buffer or
+ * the log held for them rather than the stale data at home.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+#define WRITTEN 4       // sectors the failing write gets onto the disk
+#define HELD    10      // sector written earlier through the buffer or the log
+
+static char track[USLOSS_DISK_TRACK_SIZE][USLOSS_DISK_SECTOR_SIZE];
+
+/*
+ * FailPartway
+ *
+ * Writes HELD on its own, then all of the track directly, failing after WRITTEN
+ * sectors, and checks what reads back.
+ */
+static void
+FailPartway(int t, char *held)
+{
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    int rc;
+
+    strcpy(sector, held);
+    rc = P2_DiskWrite(0, t, HELD, 1, sector);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < USLOSS_DISK_TRACK_SIZE; i++) {
+        snprintf(track[i], USLOSS_DISK_SECTOR_SIZE, "direct %d", i);
+    }
+    rc = P2DiskFailAfter(0, WRITTEN);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskWrite(0, t, 0, USLOSS_DISK_TRACK_SIZE, track);
+    TEST(rc, P2_DEVICE_ERROR);
+
+    rc = P2_DiskRead(0, t, WRITTEN - 1, 1, sector);
+    TEST(rc, P1_SUCCESS);
+    TEST(strcmp(sector, track[WRITTEN - 1]), 0);
+    rc = P2_DiskRead(0, t, HELD, 1, sector);
+    TEST(rc, P1_SUCCESS);
+    TEST(strcmp(sector, held), 0);
+}
+
+int P2_Startup(void *arg)
+{
+    P2_DiskStats stats;
+    int rc;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2DiskConfigure(0, P2_DISK_TRACKBUF | P2_DISK_DIRECT);
+    TEST(rc, P1_SUCCESS);
+    FailPartway(1, "buffered");
+    rc = P2DiskConfigure(0, P2_DISK_LOG | P2_DISK_DIRECT);
+    TEST(rc, P1_SUCCESS);
+    FailPartway(3, "logged");
+    rc = P2DiskStats(0, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.directTracks, 0);
+    rc = P2DiskConfigure(0, 0);
+    TEST(rc, P1_SUCCESS);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
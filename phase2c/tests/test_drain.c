@@ -0,0 +1,161 @@
+/*
+ * test_drain.c
+ *
+ * Tests P2DiskDrain: several processes queue writes, then the disk is drained with no
+ * time to spare. The write in progress finishes and its last track is flushed from the
+ * track buffer, the queued ones and any made afterwards fail with P1_WAIT_ABORTED, and
+ * draining again does nothing.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+#define WRITERS 4
+#define SPAN    3       // tracks each writer writes
+#define SECTORS (SPAN * USLOSS_DISK_TRACK_SIZE)
+
+static char buffers[WRITERS][SECTORS][USLOSS_DISK_SECTOR_SIZE];
+static int rcs[WRITERS];        // result of each writer's queued write
+static int lateRcs[WRITERS];    // result of the write it makes after that
+
+static int
+First(int i)
+{
+    return 1 + i * SPAN;
+}
+
+/*
+ * Writer
+ *
+ * Writes SPAN tracks, then tries once more.
+ */
+int
+Writer(void *arg)
+{
+    int i = (int) arg;
+
+    for (int j = 0; j < SECTORS; j++) {
+        snprintf(buffers[i][j], USLOSS_DISK_SECTOR_SIZE, "writer %d sector %d", i, j);
+    }
+    rcs[i] = Sys_DiskWrite(buffers[i], First(i), 0, SECTORS, 0);
+    lateRcs[i] = Sys_DiskWrite(buffers[i], First(i), 0, 1, 0);
+    return 0;
+}
+
+/*
+ * Signaller
+ *
+ * Runs below the writers, so by the time it quits they have all queued their writes.
+ */
+int
+Signaller(void *arg)
+{
+    return 0;
+}
+
+/*
+ * RawRead
+ *
+ * Reads a sector straight from the disk, once the driver has stopped.
+ */
+static void
+RawRead(int track, int first, char *sector)
+{
+    USLOSS_DeviceRequest request;
+    int rc, status;
+
+    request.opr = USLOSS_DISK_SEEK;
+    request.reg1 = (void *) track;
+    rc = USLOSS_DeviceOutput(USLOSS_DISK_DEV, 0, &request);
+    TEST(rc, USLOSS_DEV_OK);
+    rc = P1_WaitDevice(USLOSS_DISK_DEV, 0, &status);
+    TEST(rc, P1_SUCCESS);
+    request.opr = USLOSS_DISK_READ;
+    request.reg1 = (void *) first;
+    request.reg2 = sector;
+    rc = USLOSS_DeviceOutput(USLOSS_DISK_DEV, 0, &request);
+    TEST(rc, USLOSS_DEV_OK);
+    rc = P1_WaitDevice(USLOSS_DISK_DEV, 0, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, USLOSS_DEV_READY);
+}
+
+int P2_Startup(void *arg)
+{
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    char expected[USLOSS_DISK_SECTOR_SIZE];
+    int rc, pid, signaller, waitPid, status, elapsed;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2DiskConfigure(0, P2_DISK_TRACKBUF);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < WRITERS; i++) {
+        rc = P2_Spawn(MakeName("Writer", i), Writer, (void *) i, USLOSS_MIN_STACK, 3, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = P2_Spawn("Signaller", Signaller, NULL, USLOSS_MIN_STACK, 5, &signaller);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(waitPid, signaller);
+
+    // the first write is under way and the rest are queued behind it
+    rc = P2DiskDrain(0, &elapsed);
+    TEST(rc, P1_SUCCESS);
+    TEST(elapsed >= 0, 1);
+    for (int i = 0; i < WRITERS; i++) {
+        rc = P2_Wait(&waitPid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(rcs[0], P1_SUCCESS);
+    for (int i = 1; i < WRITERS; i++) {
+        TEST(rcs[i], P1_WAIT_ABORTED);
+    }
+    for (int i = 0; i < WRITERS; i++) {
+        TEST(lateRcs[i], P1_WAIT_ABORTED);
+    }
+
+    // the first writer's last track was only in the track buffer when the drain began
+    RawRead(First(0) + SPAN - 1, USLOSS_DISK_TRACK_SIZE - 1, sector);
+    snprintf(expected, sizeof(expected), "writer 0 sector %d", SECTORS - 1);
+    TEST(strcmp(sector, expected), 0);
+    // the aborted writes never reached the disk
+    RawRead(First(1), 0, sector);
+    TEST(sector[0], '\0');
+
+    rc = P2DiskDrain(0, &elapsed);
+    TEST(rc, P1_INVALID_STATE);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 1 + WRITERS * SPAN);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
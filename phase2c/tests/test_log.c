@@ -0,0 +1,124 @@
+/*
+ * test_log.c
+ *
+ * Tests the write log: scattered single-sector writes, more than the log holds, are
+ * read back with the log on and again once it has been turned off. The log won't
+ * start over data that is in its way.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+#define TRACKS  10      // the last one is the log
+#define WRITES  40      // more than the log's 16 sectors
+
+static int
+Home(int i)
+{
+    // visits every track, backwards
+    return ((WRITES - i) * 37) % ((TRACKS - 1) * USLOSS_DISK_TRACK_SIZE);
+}
+
+static void
+Check(void)
+{
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    char expected[USLOSS_DISK_SECTOR_SIZE];
+    for (int i = 0; i < WRITES; i++) {
+        int home = Home(i);
+        int rc = P2_DiskRead(0, home / USLOSS_DISK_TRACK_SIZE, home % USLOSS_DISK_TRACK_SIZE,
+                             1, sector);
+        TEST(rc, P1_SUCCESS);
+        snprintf(expected, sizeof(expected), "write %d", i);
+        TEST(strcmp(sector, expected), 0);
+    }
+}
+
+int P3_Startup(void *arg) {
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    int rc, bytes, sectors, tracks;
+
+    rc = Sys_DiskSize(0, &bytes, &sectors, &tracks);
+    TEST(rc, P1_SUCCESS);
+    TEST(tracks, TRACKS - 1);
+    rc = Sys_DiskWrite(sector, TRACKS - 1, 0, 1, 0);
+    TEST(rc, P2_INVALID_TRACK);
+
+    USLOSS_Console("Scattered writes through the log.\n");
+    for (int i = 0; i < WRITES; i++) {
+        int home = Home(i);
+        snprintf(sector, sizeof(sector), "write %d", i);
+        rc = Sys_DiskWrite(sector, home / USLOSS_DISK_TRACK_SIZE, home % USLOSS_DISK_TRACK_SIZE,
+                           1, 0);
+        TEST(rc, P1_SUCCESS);
+    }
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    int rc, waitPid, status, p3Pid;
+
+    P2ClockInit();
+    P2DiskInit();
+    memset(sector, 0, sizeof(sector));
+    strcpy(sector, "in the way");
+    rc = P2_DiskWrite(0, TRACKS - 1, 3, 1, sector);
+    TEST(rc, P1_SUCCESS);
+    rc = P2DiskConfigure(0, P2_DISK_LOG);
+    TEST(rc, P1_INVALID_STATE);
+    memset(sector, 0, sizeof(sector));
+    rc = P2_DiskWrite(0, TRACKS - 1, 3, 1, sector);
+    TEST(rc, P1_SUCCESS);
+    rc = P2DiskConfigure(0, P2_DISK_LOG);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    USLOSS_Console("Read back with the log on.\n");
+    Check();
+    USLOSS_Console("Read back with the log off.\n");
+    rc = P2DiskConfigure(0, 0);
+    TEST(rc, P1_SUCCESS);
+    Check();
+    // turning it off cleared the log
+    rc = P2DiskConfigure(0, P2_DISK_LOG);
+    TEST(rc, P1_SUCCESS);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
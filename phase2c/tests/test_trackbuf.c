@@ -0,0 +1,116 @@
+/*
+ * test_trackbuf.c
+ *
+ * Tests the track buffer: multi-track writes and scattered reads with the buffer on,
+ * then checks that the buffered writes reached the disk once it is turned off.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+#define SECTORS 40      // starts mid-track and spans three tracks
+#define FIRST   10
+
+static char buffer[SECTORS][USLOSS_DISK_SECTOR_SIZE];
+
+static void
+Fill(void)
+{
+    for (int i = 0; i < SECTORS; i++) {
+        snprintf(buffer[i], USLOSS_DISK_SECTOR_SIZE, "sector %d", i);
+    }
+}
+
+static void
+Check(int unit)
+{
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    char expected[USLOSS_DISK_SECTOR_SIZE];
+    // read back one sector at a time, last first
+    for (int i = SECTORS - 1; i >= 0; i--) {
+        int track = (FIRST + i) / USLOSS_DISK_TRACK_SIZE;
+        int first = (FIRST + i) % USLOSS_DISK_TRACK_SIZE;
+        int rc = Sys_DiskRead(sector, track, first, 1, unit);
+        TEST(rc, P1_SUCCESS);
+        snprintf(expected, sizeof(expected), "sector %d", i);
+        TEST(strcmp(sector, expected), 0);
+    }
+}
+
+int P3_Startup(void *arg) {
+    int rc;
+
+    Fill();
+    USLOSS_Console("Write through the track buffer.\n");
+    rc = Sys_DiskWrite(buffer, 0, FIRST, SECTORS, 0);
+    TEST(rc, P1_SUCCESS);
+    memset(buffer, 0, sizeof(buffer));
+
+    USLOSS_Console("Read it back in one request.\n");
+    rc = Sys_DiskRead(buffer, 0, FIRST, SECTORS, 0);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < SECTORS; i++) {
+        char expected[USLOSS_DISK_SECTOR_SIZE];
+        snprintf(expected, sizeof(expected), "sector %d", i);
+        TEST(strcmp(buffer[i], expected), 0);
+    }
+    USLOSS_Console("Read it back a sector at a time.\n");
+    Check(0);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2DiskConfigure(0, P2_DISK_TRACKBUF);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    // the writes must be on the disk once the buffer is turned off
+    rc = P2DiskConfigure(0, 0);
+    TEST(rc, P1_SUCCESS);
+    char sector[USLOSS_DISK_SECTOR_SIZE];
+    rc = P2_DiskRead(0, 2, 0, 1, sector);
+    TEST(rc, P1_SUCCESS);
+    TEST(strcmp(sector, "sector 22"), 0);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
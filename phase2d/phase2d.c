@@ -1,6 +1,8 @@
 
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <usloss.h>
 #include <phase1.h>
 #include <assert.h>
@@ -8,37 +10,214 @@
 #include <libdisk.h>
 
 #include "phase2Int.h"
+#include "phase2Ext.h"
+
+static int
+Now(void)
+{
+    int rc;
+    int now;
+    rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    return now;
+}
 
 static void     CreateStub(USLOSS_Sysargs *sysargs);
 static void     PStub(USLOSS_Sysargs *sysargs);
 static void     VStub(USLOSS_Sysargs *sysargs);
 static void     FreeStub(USLOSS_Sysargs *sysargs);
 static void     NameStub(USLOSS_Sysargs *sysargs);
+static void     FutexStub(USLOSS_Sysargs *sysargs);
+static void     SemOpStub(USLOSS_Sysargs *sysargs);
+static void     WaitAnyStub(USLOSS_Sysargs *sysargs);
+static void     MboxCreateStub(USLOSS_Sysargs *sysargs);
+static void     MboxFreeStub(USLOSS_Sysargs *sysargs);
+static void     MboxSendStub(USLOSS_Sysargs *sysargs);
+static void     MboxReceiveStub(USLOSS_Sysargs *sysargs);
+static void     MutexStub(USLOSS_Sysargs *sysargs);
+static void     RwStub(USLOSS_Sysargs *sysargs);
+static void     BarrierStub(USLOSS_Sysargs *sysargs);
+static void     CondStub(USLOSS_Sysargs *sysargs);
+static void     SemStatsStub(USLOSS_Sysargs *sysargs);
+static void     OpenStub(USLOSS_Sysargs *sysargs);
 
 /*
- * I left this useful function here for you to use for debugging. If you add -DDEBUG to CFLAGS
- * this will produce output, otherwise it won't. The message is printed including the function
- * and line from which it was called. I don't remember why it is called "debug2".
+ * Wait queues. A blocked process goes on a queue and parks with P2ProcPark; whoever
+ * wakes it takes it off the queue and unparks it. Unparking is counted, so a wakeup
+ * that comes before the process has actually blocked is not lost, and a process only
+ * stops waiting once it is off its queue, since wakeups may also be stale.
  */
+typedef struct Link {
+    int queued;     // on a queue
+    int next;       // next pid in its queue, or -1
+    void *key;      // what it is waiting for
+    int priority;   // for EnqueueByPriority
+} Link;
 
-static void debug2(char *fmt, ...)
-{
-    #ifdef DEBUG
-    va_list ap;
-    va_start(ap, fmt);
-    USLOSS_Console("[%s:%d] ", __PRETTY_FUNCTION__, __LINE__);   \
-    USLOSS_VConsole(fmt, ap);
-    #endif
-}
+typedef struct WaitQ {
+    int head;
+    int tail;
+} WaitQ;
+
+static Link links[P1_MAXPROC];
+
+#define FUTEX_BUCKETS   64
+
+static WaitQ futexQs[FUTEX_BUCKETS];
+static WaitQ mutexQs[FUTEX_BUCKETS];
+
+/*
+ * Priority inheritance for the mutexes. A process blocked on a mutex lends its priority
+ * to the owner, and through it to the owner of any mutex the owner is blocked on. The
+ * owner gives it back when it unlocks. Phase 1 schedules by the priority a process was
+ * spawned with and has no call to change it, so the loan only counts where phase 2
+ * orders processes itself: a boosted owner queues for a mutex at its inherited priority.
+ */
+#define NO_BOOST    INT_MAX
+
+static int boosts[P1_MAXPROC];          // priority inherited from waiters, or NO_BOOST
+static int *mutexWaits[P1_MAXPROC];     // the mutex each pid is blocked on, or NULL
+
+/*
+ * User semaphores. Their values are kept here rather than in phase 1 so that several
+ * can be changed at once; the phase 1 semaphore with the same sid only provides the
+ * name. Processes that can't go ahead wait in semQ in the order they blocked.
+ */
+typedef struct Sem {
+    int inUse;
+    int value;
+    char name[P1_MAXNAME+1];    // kept for P2SemStatsDump after it is freed
+    P2_SemStats stats;
+    int waiting;                // processes blocked on it
+    int lastP;                  // pid that made the last successful P, or -1
+} Sem;
+
+// the operations a process blocked in P2_SemOp is waiting to do
+typedef struct SemWait {
+    P2_SemBuf ops[P2_SEMOP_MAX];
+    int n;
+} SemWait;
+
+static Sem sems[P1_MAXSEM];
+
+/*
+ * Index of the user semaphores by name, for P2_SemOpen: a hash table whose chains run
+ * through nameNext.
+ */
+#define NAME_BUCKETS    256
+
+static int nameBuckets[NAME_BUCKETS];     // first sid in each chain, or -1
+static int nameNext[P1_MAXSEM];           // next sid in its chain, or -1
+static SemWait semWaits[P1_MAXPROC];
+static WaitQ semQ;
+
+// the semaphores a process blocked in P2_WaitAny is watching; n is 0 if it isn't
+typedef struct Watch {
+    int sids[P2_WAITANY_MAX];
+    int n;
+} Watch;
+
+static Watch watches[P1_MAXPROC];
+
+/*
+ * Mailboxes. Messages are copied into the ring of slots when sent and out of it when
+ * received, unless the sender and receiver meet, in which case the one that comes
+ * second copies the message across directly. Blocked processes wait in sendQ and
+ * recvQ with their half of the transfer in mboxWaits.
+ */
+typedef struct Mbox {
+    int inUse;
+    int slots;
+    int slotSize;
+    char *data;     // slots * slotSize bytes
+    int *sizes;     // size of the message in each slot
+    int head;       // oldest message
+    int count;
+    WaitQ sendQ;
+    WaitQ recvQ;
+} Mbox;
+
+typedef struct MboxWait {
+    char *buf;      // message to send, or where to receive
+    int size;       // size of the message to send
+    int n;          // most messages to receive
+    int *sizes;
+    int got;        // messages received
+    int done;       // the transfer was done for us
+} MboxWait;
+
+static Mbox mboxes[P2_MAXMBOX];
+static MboxWait mboxWaits[P1_MAXPROC];
+
+// reader-writer locks
+typedef struct RwLock {
+    int inUse;
+    int readers;    // readers holding it
+    int writer;     // pid of the writer holding it, or -1
+    WaitQ readQ;
+    WaitQ writeQ;
+} RwLock;
+
+static RwLock rwlocks[P2_MAXRWLOCK];
+
+// barriers and condition variables
+typedef struct Barrier {
+    int inUse;
+    int n;          // processes per round
+    int arrived;    // processes waiting in this round
+    WaitQ q;
+} Barrier;
+
+typedef struct Cond {
+    int inUse;
+    WaitQ q;
+} Cond;
+
+static Barrier barriers[P2_MAXBARRIER];
+static Cond conds[P2_MAXCOND];
 
 int P2_Startup(void *arg)
 {
     int rc, pid;
     int waitPid,status;
+    #ifdef TRACE
+    P2TraceEnable(TRUE);
+    #endif
     // initialize clock and disk drivers
-    debug2("starting\n");
     P2ClockInit();
     P2DiskInit();
+    #ifdef STATS
+    P2SyscallStatsEnable(TRUE);
+    #endif
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        links[i].queued = FALSE;
+        boosts[i] = NO_BOOST;
+    }
+    for (int i = 0; i < FUTEX_BUCKETS; i++) {
+        futexQs[i].head = -1;
+        futexQs[i].tail = -1;
+        mutexQs[i].head = -1;
+        mutexQs[i].tail = -1;
+    }
+    semQ.head = -1;
+    semQ.tail = -1;
+    for (int i = 0; i < P1_MAXPROC; i++) {
+        watches[i].n = 0;
+    }
+    for (int i = 0; i < P2_MAXMBOX; i++) {
+        mboxes[i].inUse = FALSE;
+    }
+    for (int i = 0; i < P2_MAXRWLOCK; i++) {
+        rwlocks[i].inUse = FALSE;
+    }
+    for (int i = 0; i < P2_MAXBARRIER; i++) {
+        barriers[i].inUse = FALSE;
+    }
+    for (int i = 0; i < P2_MAXCOND; i++) {
+        conds[i].inUse = FALSE;
+    }
+    for (int i = 0; i < NAME_BUCKETS; i++) {
+        nameBuckets[i] = -1;
+    }
     rc = P2_SetSyscallHandler(SYS_SEMCREATE, CreateStub);
     assert(rc == P1_SUCCESS);
     rc = P2_SetSyscallHandler(SYS_SEMP, PStub);
@@ -49,44 +228,1791 @@ int P2_Startup(void *arg)
     assert(rc == P1_SUCCESS);
     rc = P2_SetSyscallHandler(SYS_SEMNAME, NameStub);
     assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_FUTEX, FutexStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SEMOP, SemOpStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_WAITANY, WaitAnyStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MBOXCREATE, MboxCreateStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MBOXFREE, MboxFreeStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MBOXSEND, MboxSendStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MBOXRECEIVE, MboxReceiveStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_MUTEX, MutexStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_RWLOCK, RwStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_BARRIER, BarrierStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_COND, CondStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SEMSTATS, SemStatsStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SEMOPEN, OpenStub);
+    assert(rc == P1_SUCCESS);
     // ...
     rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &pid);
     assert(rc == P1_SUCCESS);
     // ...
     rc = P2_Wait(&waitPid, &status);
-    // shut down clock and disk drivers
+    // shut down the worker pool and the reaper, and clock and disk drivers
+    P2PoolShutdown();
+    P2ProcShutdown();
     P2DiskShutdown();
     P2ClockShutdown();
+    P2SyscallStatsDump();
+    P2SemStatsDump();
+    P2TraceDump();
     return 0;
 }
 
+// the chain in nameBuckets that name is in (FNV-1a)
+static int *
+NameBucket(char *name)
+{
+    unsigned int hash = 2166136261u;
+    for (char *c = name; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    }
+    return &nameBuckets[hash % NAME_BUCKETS];
+}
+
+/*
+ * Lookup
+ *
+ * Returns the user semaphore called name, or -1 if there is none.
+ */
+static int
+Lookup(char *name)
+{
+    for (int sid = *NameBucket(name); sid != -1; sid = nameNext[sid]) {
+        if (strcmp(sems[sid].name, name) == 0) {
+            return sid;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Unindex
+ *
+ * Takes a user semaphore out of the name index.
+ */
+static void
+Unindex(int sid)
+{
+    int *link = NameBucket(sems[sid].name);
+    while (*link != sid) {
+        link = &nameNext[*link];
+    }
+    *link = nameNext[sid];
+}
+
+/*
+ * SemCreate
+ *
+ * Creates a user semaphore and adds it to the name index.
+ */
+static int
+SemCreate(char *name, int value, int *sid)
+{
+    int rc = P1_SemCreate(name, 0, sid);
+    if (rc == P1_SUCCESS) {
+        Sem *sem = &sems[*sid];
+        sem->value = value;
+        rc = P1_SemName(*sid, sem->name);
+        assert(rc == P1_SUCCESS);
+        memset(&sem->stats, 0, sizeof(sem->stats));
+        sem->stats.holder = -1;
+        for (int i = 0; i < P2_SEM_CONTENDERS; i++) {
+            sem->stats.contenders[i] = -1;
+        }
+        sem->waiting = 0;
+        sem->lastP = -1;
+        int *bucket = NameBucket(sem->name);
+        nameNext[*sid] = *bucket;
+        *bucket = *sid;
+        sem->inUse = TRUE;
+    }
+    return rc;
+}
+
 static void
 CreateStub(USLOSS_Sysargs *sysargs)
 {
-    sysargs->arg4 = (void *) P1_SemCreate((char *) sysargs->arg2, (int) sysargs->arg1, 
-                                          (void *) &sysargs->arg1);
+    int sid;
+    int enabled = P2DisableInterrupts();
+    int rc = SemCreate((char *) sysargs->arg2, (int) sysargs->arg1, &sid);
+    P2RestoreInterrupts(enabled);
+    if (rc == P1_SUCCESS) {
+        sysargs->arg1 = (void *) sid;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * P2_SemOpen
+ *
+ * Returns the user semaphore called name, creating it with the given value if there
+ * is none.
+ */
+int
+P2_SemOpen(char *name, int value, int *sid, int *created)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc = P1_SUCCESS;
+    if (name == NULL) {
+        return P1_NAME_IS_NULL;
+    }
+    if (sid == NULL || created == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    // so two processes opening the same name get the same semaphore
+    int enabled = P2DisableInterrupts();
+    *sid = Lookup(name);
+    *created = *sid == -1;
+    if (*created) {
+        rc = SemCreate(name, value, sid);
+    }
+    P2RestoreInterrupts(enabled);
+    return rc;
+}
+
+static void
+OpenStub(USLOSS_Sysargs *sysargs)
+{
+    int sid = -1;
+    int created = FALSE;
+    int rc = P2_SemOpen((char *) sysargs->arg2, (int) sysargs->arg1, &sid, &created);
+    sysargs->arg1 = (void *) sid;
+    sysargs->arg2 = (void *) created;
+    sysargs->arg4 = (void *) rc;
 }
 
 static void
 PStub(USLOSS_Sysargs *sysargs)
 {
-    sysargs->arg4=(void *) P1_P((int) sysargs->arg1);
+    P2_SemBuf op = {(int) sysargs->arg1, -1};
+    sysargs->arg4 = (void *) P2_SemOp(&op, 1);
 }
 
 static void
 VStub(USLOSS_Sysargs *sysargs)
 {
-    sysargs->arg4=(void *) P1_V((int) sysargs->arg1);
+    P2_SemBuf op = {(int) sysargs->arg1, 1};
+    sysargs->arg4 = (void *) P2_SemOp(&op, 1);
 }
 
 static void
 FreeStub(USLOSS_Sysargs *sysargs)
 {
-    sysargs->arg4=(void *) P1_SemFree((int) sysargs->arg1);
+    int sid = (int) sysargs->arg1;
+    int rc;
+    if (sid < 0 || sid >= P1_MAXSEM || !sems[sid].inUse) {
+        rc = P1_INVALID_SID;
+    } else {
+        int enabled = P2DisableInterrupts();
+        rc = P1_SUCCESS;
+        for (int pid = semQ.head; pid != -1; pid = links[pid].next) {
+            for (int i = 0; i < semWaits[pid].n; i++) {
+                if (semWaits[pid].ops[i].sid == sid) {
+                    rc = P1_BLOCKED_PROCESSES;
+                }
+            }
+        }
+        if (rc == P1_SUCCESS) {
+            sems[sid].inUse = FALSE;
+            Unindex(sid);
+        }
+        P2RestoreInterrupts(enabled);
+        if (rc == P1_SUCCESS) {
+            rc = P1_SemFree(sid);
+        }
+    }
+    sysargs->arg4 = (void *) rc;
 }
 
 static void
 NameStub(USLOSS_Sysargs *sysargs)
 {
     sysargs->arg4=(void *) P1_SemName((int) sysargs->arg1,(char*) sysargs->arg2);
-}
\ No newline at end of file
+}
+/*
+ * Enqueue
+ *
+ * Adds pid to the tail of q, waiting for key. Call with interrupts disabled.
+ */
+static void
+Enqueue(WaitQ *q, int pid, void *key)
+{
+    links[pid].queued = TRUE;
+    links[pid].next = -1;
+    links[pid].key = key;
+    links[pid].priority = 0;
+    if (q->tail == -1) {
+        q->head = pid;
+    } else {
+        links[q->tail].next = pid;
+    }
+    q->tail = pid;
+}
+
+/*
+ * EnqueueByPriority
+ *
+ * Adds pid to q behind every process of the same or higher priority. Call with
+ * interrupts disabled.
+ */
+static void
+EnqueueByPriority(WaitQ *q, int pid, void *key, int priority)
+{
+    int prev = -1;
+    int next = q->head;
+    // lower numbers are higher priorities
+    while (next != -1 && links[next].priority <= priority) {
+        prev = next;
+        next = links[next].next;
+    }
+    links[pid].queued = TRUE;
+    links[pid].next = next;
+    links[pid].key = key;
+    links[pid].priority = priority;
+    if (prev == -1) {
+        q->head = pid;
+    } else {
+        links[prev].next = pid;
+    }
+    if (next == -1) {
+        q->tail = pid;
+    }
+}
+
+/*
+ * Dequeue
+ *
+ * Removes and returns the first pid in q waiting for key (any key if key is NULL), or
+ * -1 if there is none. Call with interrupts disabled.
+ */
+static int
+Dequeue(WaitQ *q, void *key)
+{
+    int prev = -1;
+    for (int pid = q->head; pid != -1; prev = pid, pid = links[pid].next) {
+        if (key != NULL && links[pid].key != key) {
+            continue;
+        }
+        if (prev == -1) {
+            q->head = links[pid].next;
+        } else {
+            links[prev].next = links[pid].next;
+        }
+        if (q->tail == pid) {
+            q->tail = prev;
+        }
+        links[pid].queued = FALSE;
+        return pid;
+    }
+    return -1;
+}
+
+/*
+ * Unlink
+ *
+ * Removes pid from q. Call with interrupts disabled.
+ */
+static void
+Unlink(WaitQ *q, int pid)
+{
+    int prev = -1;
+    for (int p = q->head; p != -1; prev = p, p = links[p].next) {
+        if (p != pid) {
+            continue;
+        }
+        if (prev == -1) {
+            q->head = links[pid].next;
+        } else {
+            links[prev].next = links[pid].next;
+        }
+        if (q->tail == pid) {
+            q->tail = prev;
+        }
+        links[pid].queued = FALSE;
+        return;
+    }
+}
+
+/*
+ * Park
+ *
+ * Blocks the caller until it has been taken off its queue. Call with interrupts
+ * enabled, after putting the caller on a queue.
+ */
+static void
+Park(int pid)
+{
+    int rc;
+    while (links[pid].queued) {
+        rc = P2ProcPark(-1);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+// the queue processes waiting on addr are in
+static WaitQ *
+FutexQ(int *addr)
+{
+    return &futexQs[((unsigned long) addr >> 2) % FUTEX_BUCKETS];
+}
+
+/*
+ * P2_FutexWait
+ *
+ * Blocks on addr if it still holds value.
+ */
+int
+P2_FutexWait(int *addr, int value)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int start;
+    if (addr == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    if (*addr != value) {
+        P2RestoreInterrupts(enabled);
+        return P2_WOULD_BLOCK;
+    }
+    Enqueue(FutexQ(addr), pid, addr);
+    P2RestoreInterrupts(enabled);
+    start = Now();
+    P2_TRACE(P2_TRACE_SEM_P, 'B', (int) addr);
+    Park(pid);
+    P2_TRACE(P2_TRACE_SEM_P, 'E', (int) addr);
+    P2ProcStatsFor(pid)->semWait += Now() - start;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_FutexWake
+ *
+ * Wakes up to n processes blocked on addr.
+ */
+int
+P2_FutexWake(int *addr, int n, int *woken)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pids[P1_MAXPROC];
+    int count = 0;
+    if (addr == NULL || woken == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    while (count < n) {
+        int pid = Dequeue(FutexQ(addr), addr);
+        if (pid == -1) {
+            break;
+        }
+        pids[count++] = pid;
+    }
+    P2RestoreInterrupts(enabled);
+    P2_TRACE(P2_TRACE_SEM_V, 'i', (int) addr);
+    for (int i = 0; i < count; i++) {
+        P2ProcUnpark(pids[i]);
+    }
+    *woken = count;
+    return P1_SUCCESS;
+}
+
+static void
+FutexStub(USLOSS_Sysargs *sysargs)
+{
+    int woken = 0;
+    int rc;
+    switch ((int) sysargs->arg5) {
+        case P2_FUTEX_WAIT:
+            rc = P2_FutexWait((int *) sysargs->arg1, (int) sysargs->arg2);
+            break;
+        case P2_FUTEX_WAKE:
+            rc = P2_FutexWake((int *) sysargs->arg1, (int) sysargs->arg2, &woken);
+            sysargs->arg1 = (void *) woken;
+            break;
+        default:
+            rc = P2_INVALID_SYSCALL;
+            break;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * TryOps
+ *
+ * Applies all of the operations if none of the semaphores would go negative, and
+ * returns whether it did. Call with interrupts disabled.
+ */
+static int
+TryOps(P2_SemBuf *ops, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        Sem *sem = &sems[ops[i].sid];
+        sem->value += ops[i].delta;
+        if (sem->value < 0) {
+            break;
+        }
+    }
+    if (i == n) {
+        return TRUE;
+    }
+    // undo them
+    for (; i >= 0; i--) {
+        sems[ops[i].sid].value -= ops[i].delta;
+    }
+    return FALSE;
+}
+
+/*
+ * GrantWaiters
+ *
+ * Lets every waiting process that now can go ahead do its operations, in the order
+ * they blocked, and stores their pids in pids. Returns how many there are. Call with
+ * interrupts disabled.
+ */
+static int
+GrantWaiters(int *pids)
+{
+    int count = 0;
+    int granted = TRUE;
+    // a waiter's own V's may let earlier ones go ahead
+    while (granted) {
+        granted = FALSE;
+        for (int pid = semQ.head; pid != -1; ) {
+            int next = links[pid].next;
+            if (TryOps(semWaits[pid].ops, semWaits[pid].n)) {
+                Dequeue(&semQ, &semWaits[pid]);
+                for (int i = 0; i < semWaits[pid].n; i++) {
+                    if (semWaits[pid].ops[i].delta < 0) {
+                        sems[semWaits[pid].ops[i].sid].waiting--;
+                        sems[semWaits[pid].ops[i].sid].lastP = pid;
+                    }
+                }
+                pids[count++] = pid;
+                granted = TRUE;
+            }
+            pid = next;
+        }
+    }
+    return count;
+}
+
+/*
+ * WakeWatchers
+ *
+ * Unparks the processes in P2_WaitAny watching a semaphore that ops raised.
+ */
+static void
+WakeWatchers(P2_SemBuf *ops, int n)
+{
+    for (int pid = 0; pid < P1_MAXPROC; pid++) {
+        int watched = FALSE;
+        for (int i = 0; i < watches[pid].n && !watched; i++) {
+            for (int j = 0; j < n; j++) {
+                if (ops[j].delta > 0 && ops[j].sid == watches[pid].sids[i]) {
+                    watched = TRUE;
+                }
+            }
+        }
+        if (watched) {
+            P2ProcUnpark(pid);
+        }
+    }
+}
+
+/*
+ * Release
+ *
+ * Wakes the processes GrantWaiters let go ahead, and whoever is watching what they and
+ * ops raised.
+ */
+static void
+Release(P2_SemBuf *ops, int n, int *pids, int count)
+{
+    if (ops != NULL) {
+        WakeWatchers(ops, n);
+    }
+    // before unparking, while their operations are still in semWaits
+    for (int i = 0; i < count; i++) {
+        WakeWatchers(semWaits[pids[i]].ops, semWaits[pids[i]].n);
+    }
+    for (int i = 0; i < count; i++) {
+        P2ProcUnpark(pids[i]);
+    }
+}
+
+/*
+ * Blame
+ *
+ * Counts a block against pid, the last process to P before it. If pid isn't one of the
+ * contenders and there is no room for it, it replaces the one blamed least and takes
+ * over its count. Call with interrupts disabled.
+ */
+static void
+Blame(P2_SemStats *stats, int pid)
+{
+    int slot = -1;
+    for (int i = 0; i < P2_SEM_CONTENDERS && slot == -1; i++) {
+        if (stats->contenders[i] == pid) {
+            slot = i;
+        }
+    }
+    if (slot == -1) {
+        slot = 0;
+        for (int i = 1; i < P2_SEM_CONTENDERS; i++) {
+            if (stats->blames[i] < stats->blames[slot]) {
+                slot = i;
+            }
+        }
+        stats->contenders[slot] = pid;
+    }
+    stats->blames[slot]++;
+    // the holder was blamed most before, so only pid can have overtaken it
+    int most = slot;
+    for (int i = 0; i < P2_SEM_CONTENDERS; i++) {
+        if (stats->contenders[i] == stats->holder && stats->blames[i] >= stats->blames[slot]) {
+            most = i;
+        }
+    }
+    stats->holder = stats->contenders[most];
+}
+
+/*
+ * P2_SemOp
+ *
+ * Applies a set of operations to user semaphores atomically.
+ */
+int
+P2_SemOp(P2_SemBuf *ops, int n)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int pids[P1_MAXPROC];
+    int count = 0;
+    int raises = FALSE;
+    if (ops == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (n <= 0 || n > P2_SEMOP_MAX) {
+        return P1_INVALID_STATE;
+    }
+    for (int i = 0; i < n; i++) {
+        if (ops[i].sid < 0 || ops[i].sid >= P1_MAXSEM || !sems[ops[i].sid].inUse) {
+            return P1_INVALID_SID;
+        }
+        if (ops[i].delta > 0) {
+            raises = TRUE;
+            P2_TRACE(P2_TRACE_SEM_V, 'i', ops[i].sid);
+        }
+    }
+    int enabled = P2DisableInterrupts();
+    for (int i = 0; i < n; i++) {
+        if (ops[i].delta < 0) {
+            sems[ops[i].sid].stats.p++;
+        }
+    }
+    // every raise lets through the waiters it can, so none of them can go ahead now and
+    // there is nobody for us to overtake; an operation that only raises always succeeds
+    if (TryOps(ops, n)) {
+        for (int i = 0; i < n; i++) {
+            if (ops[i].delta < 0) {
+                sems[ops[i].sid].lastP = pid;
+            }
+        }
+        if (raises) {
+            count = GrantWaiters(pids);
+        }
+        P2RestoreInterrupts(enabled);
+        Release(raises ? ops : NULL, n, pids, count);
+        return P1_SUCCESS;
+    }
+    memcpy(semWaits[pid].ops, ops, n * sizeof(P2_SemBuf));
+    semWaits[pid].n = n;
+    Enqueue(&semQ, pid, &semWaits[pid]);
+    for (int i = 0; i < n; i++) {
+        if (ops[i].delta < 0) {
+            sems[ops[i].sid].waiting++;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        Sem *sem = &sems[ops[i].sid];
+        if (ops[i].delta < 0) {
+            sem->stats.blocked++;
+            if (sem->waiting > sem->stats.maxQueue) {
+                sem->stats.maxQueue = sem->waiting;
+            }
+            if (sem->lastP != -1) {
+                Blame(&sem->stats, sem->lastP);
+            }
+        }
+    }
+    P2RestoreInterrupts(enabled);
+    int start = Now();
+    P2_TRACE(P2_TRACE_SEM_P, 'B', ops[0].sid);
+    Park(pid);
+    P2_TRACE(P2_TRACE_SEM_P, 'E', ops[0].sid);
+    int waited = Now() - start;
+    P2ProcStatsFor(pid)->semWait += waited;
+    for (int i = 0; i < n; i++) {
+        P2_SemStats *stats = &sems[ops[i].sid].stats;
+        if (ops[i].delta < 0) {
+            stats->totalWait += waited;
+            if (waited > stats->maxWait) {
+                stats->maxWait = waited;
+            }
+        }
+    }
+    return P1_SUCCESS;
+}
+
+static void
+SemOpStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg4 = (void *) P2_SemOp((P2_SemBuf *) sysargs->arg1, (int) sysargs->arg2);
+}
+
+/*
+ * CheckObj
+ *
+ * Consumes the object if it is ready. Returns P2_WOULD_BLOCK if it isn't.
+ */
+static int
+CheckObj(P2_WaitObj *obj)
+{
+    int rc;
+    int enabled;
+    switch (obj->type) {
+        case P2_WAIT_SEM: {
+            P2_SemBuf op = {obj->id, -1};
+            enabled = P2DisableInterrupts();
+            // processes in semQ can't go ahead, or they would have been let through
+            rc = TryOps(&op, 1) ? P1_SUCCESS : P2_WOULD_BLOCK;
+            if (rc == P1_SUCCESS) {
+                sems[obj->id].stats.p++;
+                sems[obj->id].lastP = P1_GetPid();
+            }
+            P2RestoreInterrupts(enabled);
+            obj->result = 0;
+            return rc;
+        }
+        case P2_WAIT_CHILD:
+            return P2_WaitEx(obj->id, 0, &obj->pid, &obj->result);
+        case P2_WAIT_DISK:
+            return P2_DiskPoll(obj->id, &obj->result);
+    }
+    return P2_INVALID_FLAGS;
+}
+
+/*
+ * P2_WaitAny
+ *
+ * Waits until one of several semaphores, children and disk requests is ready.
+ */
+int
+P2_WaitAny(P2_WaitObj *objs, int n, int timeout, int *which)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int deadline = timeout > 0 ? Now() + timeout : -1;
+    int rc;
+    if (objs == NULL || which == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (n <= 0 || n > P2_WAITANY_MAX) {
+        return P1_INVALID_STATE;
+    }
+    if (timeout < -1) {
+        return P2_INVALID_TIMEOUT;
+    }
+    Watch watch;
+    watch.n = 0;
+    for (int i = 0; i < n; i++) {
+        if (objs[i].type == P2_WAIT_SEM) {
+            if (objs[i].id < 0 || objs[i].id >= P1_MAXSEM || !sems[objs[i].id].inUse) {
+                return P1_INVALID_SID;
+            }
+            watch.sids[watch.n++] = objs[i].id;
+        } else if (objs[i].type != P2_WAIT_CHILD && objs[i].type != P2_WAIT_DISK) {
+            return P2_INVALID_FLAGS;
+        }
+    }
+    // watch before looking, so a V in between still wakes us
+    watches[pid] = watch;
+    for (;;) {
+        for (int i = 0; i < n; i++) {
+            rc = CheckObj(&objs[i]);
+            if (rc != P2_WOULD_BLOCK) {
+                watches[pid].n = 0;
+                *which = i;
+                return rc;
+            }
+        }
+        rc = timeout == 0 ? P2_WOULD_BLOCK : P2ProcPark(deadline);
+        if (rc != P1_SUCCESS) {
+            watches[pid].n = 0;
+            return rc;
+        }
+    }
+}
+
+static void
+WaitAnyStub(USLOSS_Sysargs *sysargs)
+{
+    int which = -1;
+    int rc = P2_WaitAny((P2_WaitObj *) sysargs->arg1, (int) sysargs->arg2,
+                        (int) sysargs->arg3, &which);
+    sysargs->arg1 = (void *) which;
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * P2_MboxCreate
+ *
+ * Creates a mailbox of slots messages of up to slotSize bytes.
+ */
+int
+P2_MboxCreate(int slots, int slotSize, int *mbox)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int id;
+    if (mbox == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    // dividing rather than multiplying, which could overflow
+    if (slots <= 0 || slotSize <= 0 || slots > P2_MBOX_MAXBYTES / slotSize) {
+        return P2_INVALID_SIZE;
+    }
+    char *data = malloc(slots * slotSize);
+    int *sizes = malloc(slots * sizeof(int));
+    if (data == NULL || sizes == NULL) {
+        free(data);
+        free(sizes);
+        return P2_INVALID_SIZE;
+    }
+    int enabled = P2DisableInterrupts();
+    for (id = 0; id < P2_MAXMBOX && mboxes[id].inUse; id++) {
+    }
+    if (id == P2_MAXMBOX) {
+        P2RestoreInterrupts(enabled);
+        free(data);
+        free(sizes);
+        return P2_TOO_MANY_MBOXES;
+    }
+    Mbox *box = &mboxes[id];
+    box->inUse = TRUE;
+    box->slots = slots;
+    box->slotSize = slotSize;
+    box->data = data;
+    box->sizes = sizes;
+    box->head = 0;
+    box->count = 0;
+    box->sendQ.head = box->sendQ.tail = -1;
+    box->recvQ.head = box->recvQ.tail = -1;
+    P2RestoreInterrupts(enabled);
+    *mbox = id;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_MboxFree
+ *
+ * Frees a mailbox, and the messages in it.
+ */
+int
+P2_MboxFree(int mbox)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (mbox < 0 || mbox >= P2_MAXMBOX || !mboxes[mbox].inUse) {
+        return P2_INVALID_MBOX;
+    }
+    Mbox *box = &mboxes[mbox];
+    int enabled = P2DisableInterrupts();
+    if (box->sendQ.head != -1 || box->recvQ.head != -1) {
+        P2RestoreInterrupts(enabled);
+        return P1_BLOCKED_PROCESSES;
+    }
+    box->inUse = FALSE;
+    P2RestoreInterrupts(enabled);
+    free(box->data);
+    free(box->sizes);
+    return P1_SUCCESS;
+}
+
+/*
+ * MboxBlock
+ *
+ * Puts the caller on q and waits until another process has done its transfer, or
+ * until deadline. Call with interrupts disabled; returns with them restored.
+ */
+static int
+MboxBlock(WaitQ *q, int pid, int deadline, int enabled)
+{
+    int rc;
+    MboxWait *wait = &mboxWaits[pid];
+    wait->done = FALSE;
+    Enqueue(q, pid, wait);
+    P2RestoreInterrupts(enabled);
+    for (;;) {
+        // wakeups may be stale, so only done counts
+        rc = P2ProcPark(deadline);
+        enabled = P2DisableInterrupts();
+        if (wait->done) {
+            P2RestoreInterrupts(enabled);
+            return P1_SUCCESS;
+        }
+        if (rc == P2_TIMEOUT) {
+            Dequeue(q, wait);
+            P2RestoreInterrupts(enabled);
+            return P2_TIMEOUT;
+        }
+        P2RestoreInterrupts(enabled);
+    }
+}
+
+/*
+ * Store
+ *
+ * Copies a message into the next free slot. Call with interrupts disabled.
+ */
+static void
+Store(Mbox *box, char *msg, int size)
+{
+    int slot = (box->head + box->count) % box->slots;
+    memcpy(box->data + slot * box->slotSize, msg, size);
+    box->sizes[slot] = size;
+    box->count++;
+}
+
+/*
+ * P2_MboxSend
+ *
+ * Sends a message, waiting for room if the mailbox is full.
+ */
+int
+P2_MboxSend(int mbox, void *msg, int size, int timeout)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int deadline = timeout > 0 ? Now() + timeout : -1;
+    if (mbox < 0 || mbox >= P2_MAXMBOX || !mboxes[mbox].inUse) {
+        return P2_INVALID_MBOX;
+    }
+    Mbox *box = &mboxes[mbox];
+    if (size < 0 || size > box->slotSize) {
+        return P2_INVALID_SIZE;
+    }
+    if (timeout < -1) {
+        return P2_INVALID_TIMEOUT;
+    }
+    if (msg == NULL && size > 0) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    // a waiting receiver means the mailbox is empty
+    int receiver = Dequeue(&box->recvQ, NULL);
+    if (receiver != -1) {
+        MboxWait *wait = &mboxWaits[receiver];
+        memcpy(wait->buf, msg, size);
+        wait->sizes[0] = size;
+        wait->got = 1;
+        wait->done = TRUE;
+        P2RestoreInterrupts(enabled);
+        P2ProcUnpark(receiver);
+        return P1_SUCCESS;
+    }
+    if (box->count < box->slots) {
+        Store(box, msg, size);
+        P2RestoreInterrupts(enabled);
+        return P1_SUCCESS;
+    }
+    if (timeout == 0) {
+        P2RestoreInterrupts(enabled);
+        return P2_WOULD_BLOCK;
+    }
+    mboxWaits[pid].buf = msg;
+    mboxWaits[pid].size = size;
+    return MboxBlock(&box->sendQ, pid, deadline, enabled);
+}
+
+/*
+ * P2_MboxReceive
+ *
+ * Receives up to n messages, waiting for one if the mailbox is empty.
+ */
+int
+P2_MboxReceive(int mbox, void *buf, int n, int *sizes, int timeout, int *got)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int deadline = timeout > 0 ? Now() + timeout : -1;
+    int pids[P1_MAXPROC];
+    int woken = 0;
+    int count = 0;
+    int rc;
+    if (mbox < 0 || mbox >= P2_MAXMBOX || !mboxes[mbox].inUse) {
+        return P2_INVALID_MBOX;
+    }
+    if (buf == NULL || sizes == NULL || got == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (n <= 0) {
+        return P2_INVALID_SIZE;
+    }
+    if (timeout < -1) {
+        return P2_INVALID_TIMEOUT;
+    }
+    Mbox *box = &mboxes[mbox];
+    char *out = buf;
+    int enabled = P2DisableInterrupts();
+    while (count < n) {
+        if (box->count > 0) {
+            memcpy(out + count * box->slotSize, box->data + box->head * box->slotSize,
+                   box->sizes[box->head]);
+            sizes[count++] = box->sizes[box->head];
+            box->head = (box->head + 1) % box->slots;
+            box->count--;
+            continue;
+        }
+        // senders only wait once the slots are full, so theirs come next
+        int sender = Dequeue(&box->sendQ, NULL);
+        if (sender == -1) {
+            break;
+        }
+        memcpy(out + count * box->slotSize, mboxWaits[sender].buf, mboxWaits[sender].size);
+        sizes[count++] = mboxWaits[sender].size;
+        mboxWaits[sender].done = TRUE;
+        pids[woken++] = sender;
+    }
+    // senders still waiting take the slots that were freed
+    while (box->count < box->slots) {
+        int sender = Dequeue(&box->sendQ, NULL);
+        if (sender == -1) {
+            break;
+        }
+        Store(box, mboxWaits[sender].buf, mboxWaits[sender].size);
+        mboxWaits[sender].done = TRUE;
+        pids[woken++] = sender;
+    }
+    if (count > 0) {
+        P2RestoreInterrupts(enabled);
+        for (int i = 0; i < woken; i++) {
+            P2ProcUnpark(pids[i]);
+        }
+        *got = count;
+        return P1_SUCCESS;
+    }
+    if (timeout == 0) {
+        P2RestoreInterrupts(enabled);
+        return P2_WOULD_BLOCK;
+    }
+    mboxWaits[pid].buf = buf;
+    mboxWaits[pid].n = n;
+    mboxWaits[pid].sizes = sizes;
+    mboxWaits[pid].got = 0;
+    rc = MboxBlock(&box->recvQ, pid, deadline, enabled);
+    if (rc == P1_SUCCESS) {
+        *got = mboxWaits[pid].got;
+    }
+    return rc;
+}
+
+static void
+MboxCreateStub(USLOSS_Sysargs *sysargs)
+{
+    int mbox = -1;
+    int rc = P2_MboxCreate((int) sysargs->arg1, (int) sysargs->arg2, &mbox);
+    sysargs->arg1 = (void *) mbox;
+    sysargs->arg4 = (void *) rc;
+}
+
+static void
+MboxFreeStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg4 = (void *) P2_MboxFree((int) sysargs->arg1);
+}
+
+static void
+MboxSendStub(USLOSS_Sysargs *sysargs)
+{
+    int rc = P2_MboxSend((int) sysargs->arg1, sysargs->arg2, (int) sysargs->arg3,
+                         (int) sysargs->arg5);
+    sysargs->arg4 = (void *) rc;
+}
+
+static void
+MboxReceiveStub(USLOSS_Sysargs *sysargs)
+{
+    int got = 0;
+    int rc = P2_MboxReceive((int) sysargs->arg1, sysargs->arg2, (int) sysargs->arg3,
+                            (int *) sysargs->arg4, (int) sysargs->arg5, &got);
+    sysargs->arg1 = (void *) got;
+    sysargs->arg4 = (void *) rc;
+}
+
+// the queue processes waiting for the mutex at word are in
+static WaitQ *
+MutexQ(int *word)
+{
+    return &mutexQs[((unsigned long) word >> 2) % FUTEX_BUCKETS];
+}
+
+/*
+ * Inherited
+ *
+ * The highest priority among the processes blocked on mutexes pid owns, or NO_BOOST.
+ * Call with interrupts disabled.
+ */
+static int
+Inherited(int pid)
+{
+    int priority = NO_BOOST;
+    for (int i = 0; i < FUTEX_BUCKETS; i++) {
+        for (int p = mutexQs[i].head; p != -1; p = links[p].next) {
+            int *word = links[p].key;
+            if ((*word & ~P2_MUTEX_WAITERS) == pid + 1 && links[p].priority < priority) {
+                priority = links[p].priority;
+            }
+        }
+    }
+    return priority;
+}
+
+/*
+ * Boost
+ *
+ * Lends priority to owner and on down the chain of mutex owners it is blocked behind.
+ * Call with interrupts disabled.
+ */
+static void
+Boost(int owner, int priority)
+{
+    // a deadlocked cycle ends it, since nobody is boosted to the same priority twice;
+    // so does an owner that isn't a process, read from a word the user has overwritten
+    while (owner >= 0 && owner < P1_MAXPROC && priority < boosts[owner]) {
+        boosts[owner] = priority;
+        int *word = mutexWaits[owner];
+        if (word == NULL || links[owner].priority <= priority) {
+            break;
+        }
+        // move it up its queue, then boost whoever it is waiting on
+        Unlink(MutexQ(word), owner);
+        EnqueueByPriority(MutexQ(word), owner, word, priority);
+        owner = (*word & ~P2_MUTEX_WAITERS) - 1;
+    }
+}
+
+/*
+ * P2_MutexLock
+ *
+ * Takes the mutex at word, blocking until its owner hands it over. A blocked caller
+ * lends its priority to the owner.
+ */
+int
+P2_MutexLock(int *word)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int rc;
+    P1_ProcInfo info;
+    if (word == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    rc = P1_GetProcInfo(pid, &info);
+    assert(rc == P1_SUCCESS);
+    int enabled = P2DisableInterrupts();
+    int owner = (*word & ~P2_MUTEX_WAITERS) - 1;
+    if (owner == -1) {
+        // unlocked since the caller looked
+        *word = (pid + 1) | (*word & P2_MUTEX_WAITERS);
+        P2RestoreInterrupts(enabled);
+        return P1_SUCCESS;
+    }
+    // the word is in user memory, so it may hold anything
+    if (owner == pid || owner < 0 || owner >= P1_MAXPROC) {
+        P2RestoreInterrupts(enabled);
+        return P1_INVALID_STATE;
+    }
+    // from now on the owner has to trap to unlock
+    *word |= P2_MUTEX_WAITERS;
+    int priority = info.priority < boosts[pid] ? info.priority : boosts[pid];
+    mutexWaits[pid] = word;
+    EnqueueByPriority(MutexQ(word), pid, word, priority);
+    Boost(owner, priority);
+    P2RestoreInterrupts(enabled);
+    int start = Now();
+    P2_TRACE(P2_TRACE_SEM_P, 'B', (int) word);
+    Park(pid);
+    P2_TRACE(P2_TRACE_SEM_P, 'E', (int) word);
+    P2ProcStatsFor(pid)->semWait += Now() - start;
+    // the unlocker made us the owner
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_MutexUnlock
+ *
+ * Releases the mutex at word, handing it to the highest priority waiter, and gives back
+ * the priority the caller inherited from that mutex's waiters.
+ */
+int
+P2_MutexUnlock(int *word)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    if (word == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    if ((*word & ~P2_MUTEX_WAITERS) != pid + 1) {
+        P2RestoreInterrupts(enabled);
+        return P2_NOT_OWNER;
+    }
+    int next = Dequeue(MutexQ(word), word);
+    if (next == -1) {
+        *word = 0;
+        boosts[pid] = Inherited(pid);
+        P2RestoreInterrupts(enabled);
+        return P1_SUCCESS;
+    }
+    mutexWaits[next] = NULL;
+    *word = next + 1;
+    for (int p = MutexQ(word)->head; p != -1; p = links[p].next) {
+        if (links[p].key == word) {
+            *word |= P2_MUTEX_WAITERS;
+            break;
+        }
+    }
+    // the waiters left on word now lend to next, and what they lent pid goes back
+    boosts[next] = Inherited(next);
+    boosts[pid] = Inherited(pid);
+    P2RestoreInterrupts(enabled);
+    P2_TRACE(P2_TRACE_SEM_V, 'i', (int) word);
+    P2ProcUnpark(next);
+    return P1_SUCCESS;
+}
+
+static void
+MutexStub(USLOSS_Sysargs *sysargs)
+{
+    int rc;
+    switch ((int) sysargs->arg5) {
+        case P2_MUTEX_LOCK:
+            rc = P2_MutexLock((int *) sysargs->arg1);
+            break;
+        case P2_MUTEX_UNLOCK:
+            rc = P2_MutexUnlock((int *) sysargs->arg1);
+            break;
+        default:
+            rc = P2_INVALID_SYSCALL;
+            break;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * P2_RwCreate
+ *
+ * Creates a reader-writer lock.
+ */
+int
+P2_RwCreate(int *rw)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int id;
+    if (rw == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    for (id = 0; id < P2_MAXRWLOCK && rwlocks[id].inUse; id++) {
+    }
+    if (id == P2_MAXRWLOCK) {
+        P2RestoreInterrupts(enabled);
+        return P2_TOO_MANY_RWLOCKS;
+    }
+    RwLock *lock = &rwlocks[id];
+    lock->inUse = TRUE;
+    lock->readers = 0;
+    lock->writer = -1;
+    lock->readQ.head = lock->readQ.tail = -1;
+    lock->writeQ.head = lock->writeQ.tail = -1;
+    P2RestoreInterrupts(enabled);
+    *rw = id;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_RwFree
+ *
+ * Frees a reader-writer lock that nobody holds.
+ */
+int
+P2_RwFree(int rw)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc = P1_SUCCESS;
+    if (rw < 0 || rw >= P2_MAXRWLOCK || !rwlocks[rw].inUse) {
+        return P2_INVALID_RWLOCK;
+    }
+    RwLock *lock = &rwlocks[rw];
+    int enabled = P2DisableInterrupts();
+    if (lock->readers > 0 || lock->writer != -1) {
+        rc = P1_BLOCKED_PROCESSES;
+    } else {
+        lock->inUse = FALSE;
+    }
+    P2RestoreInterrupts(enabled);
+    return rc;
+}
+
+/*
+ * RwAcquire
+ *
+ * Takes the lock for reading or writing, or waits in q to be handed it.
+ */
+static int
+RwAcquire(int rw, int write)
+{
+    int pid = P1_GetPid();
+    if (rw < 0 || rw >= P2_MAXRWLOCK || !rwlocks[rw].inUse) {
+        return P2_INVALID_RWLOCK;
+    }
+    RwLock *lock = &rwlocks[rw];
+    int enabled = P2DisableInterrupts();
+    if (lock->writer == pid) {
+        P2RestoreInterrupts(enabled);
+        return P1_INVALID_STATE;
+    }
+    if (write && lock->writer == -1 && lock->readers == 0) {
+        lock->writer = pid;
+        P2RestoreInterrupts(enabled);
+        return P1_SUCCESS;
+    }
+    // readers wait behind waiting writers
+    if (!write && lock->writer == -1 && lock->writeQ.head == -1) {
+        lock->readers++;
+        P2RestoreInterrupts(enabled);
+        return P1_SUCCESS;
+    }
+    Enqueue(write ? &lock->writeQ : &lock->readQ, pid, lock);
+    P2RestoreInterrupts(enabled);
+    int start = Now();
+    P2_TRACE(P2_TRACE_SEM_P, 'B', rw);
+    Park(pid);
+    P2_TRACE(P2_TRACE_SEM_P, 'E', rw);
+    P2ProcStatsFor(pid)->semWait += Now() - start;
+    return P1_SUCCESS;
+}
+
+int
+P2_RwRead(int rw)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    return RwAcquire(rw, FALSE);
+}
+
+int
+P2_RwWrite(int rw)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    return RwAcquire(rw, TRUE);
+}
+
+/*
+ * P2_RwUnlock
+ *
+ * Releases the caller's hold on the lock, and hands it on if it is now free.
+ */
+int
+P2_RwUnlock(int rw)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int pids[P1_MAXPROC];
+    int count = 0;
+    int wasWriter;
+    if (rw < 0 || rw >= P2_MAXRWLOCK || !rwlocks[rw].inUse) {
+        return P2_INVALID_RWLOCK;
+    }
+    RwLock *lock = &rwlocks[rw];
+    int enabled = P2DisableInterrupts();
+    wasWriter = lock->writer == pid;
+    if (wasWriter) {
+        lock->writer = -1;
+    } else if (lock->writer == -1 && lock->readers > 0) {
+        lock->readers--;
+    } else {
+        P2RestoreInterrupts(enabled);
+        return P2_NOT_OWNER;
+    }
+    if (lock->readers == 0) {
+        // after a writer the readers go first, so writers can't starve them
+        if (lock->readQ.head != -1 && (wasWriter || lock->writeQ.head == -1)) {
+            for (int next; (next = Dequeue(&lock->readQ, NULL)) != -1; ) {
+                lock->readers++;
+                pids[count++] = next;
+            }
+        } else if (lock->writeQ.head != -1) {
+            lock->writer = Dequeue(&lock->writeQ, NULL);
+            pids[count++] = lock->writer;
+        }
+    }
+    P2RestoreInterrupts(enabled);
+    P2_TRACE(P2_TRACE_SEM_V, 'i', rw);
+    for (int i = 0; i < count; i++) {
+        P2ProcUnpark(pids[i]);
+    }
+    return P1_SUCCESS;
+}
+
+static void
+RwStub(USLOSS_Sysargs *sysargs)
+{
+    int rw = (int) sysargs->arg1;
+    int rc;
+    switch ((int) sysargs->arg5) {
+        case P2_RW_CREATE:
+            rc = P2_RwCreate(&rw);
+            sysargs->arg1 = (void *) rw;
+            break;
+        case P2_RW_READ:
+            rc = P2_RwRead(rw);
+            break;
+        case P2_RW_WRITE:
+            rc = P2_RwWrite(rw);
+            break;
+        case P2_RW_UNLOCK:
+            rc = P2_RwUnlock(rw);
+            break;
+        case P2_RW_FREE:
+            rc = P2_RwFree(rw);
+            break;
+        default:
+            rc = P2_INVALID_SYSCALL;
+            break;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * WakeAll
+ *
+ * Takes every process off q and wakes them. Call with interrupts disabled; returns
+ * with them restored.
+ */
+static void
+WakeAll(WaitQ *q, int enabled)
+{
+    int pids[P1_MAXPROC];
+    int count = 0;
+    for (int pid; (pid = Dequeue(q, NULL)) != -1; ) {
+        pids[count++] = pid;
+    }
+    P2RestoreInterrupts(enabled);
+    for (int i = 0; i < count; i++) {
+        P2ProcUnpark(pids[i]);
+    }
+}
+
+/*
+ * Block
+ *
+ * Puts the caller on q and parks it until it is woken. Call with interrupts disabled.
+ */
+static void
+Block(WaitQ *q, int pid, void *key, int enabled)
+{
+    Enqueue(q, pid, key);
+    P2RestoreInterrupts(enabled);
+    int start = Now();
+    P2_TRACE(P2_TRACE_SEM_P, 'B', (int) key);
+    Park(pid);
+    P2_TRACE(P2_TRACE_SEM_P, 'E', (int) key);
+    P2ProcStatsFor(pid)->semWait += Now() - start;
+}
+
+/*
+ * P2_BarrierCreate
+ *
+ * Creates a barrier for n processes.
+ */
+int
+P2_BarrierCreate(int n, int *barrier)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int id;
+    if (barrier == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    if (n <= 0 || n > P1_MAXPROC) {
+        return P1_INVALID_STATE;
+    }
+    int enabled = P2DisableInterrupts();
+    for (id = 0; id < P2_MAXBARRIER && barriers[id].inUse; id++) {
+    }
+    if (id == P2_MAXBARRIER) {
+        P2RestoreInterrupts(enabled);
+        return P2_TOO_MANY_BARRIERS;
+    }
+    barriers[id].inUse = TRUE;
+    barriers[id].n = n;
+    barriers[id].arrived = 0;
+    barriers[id].q.head = barriers[id].q.tail = -1;
+    P2RestoreInterrupts(enabled);
+    *barrier = id;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_BarrierWait
+ *
+ * Waits until the rest of this round's processes have arrived. The last one to arrive
+ * wakes the others.
+ */
+int
+P2_BarrierWait(int barrier)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    if (barrier < 0 || barrier >= P2_MAXBARRIER || !barriers[barrier].inUse) {
+        return P2_INVALID_BARRIER;
+    }
+    Barrier *b = &barriers[barrier];
+    int enabled = P2DisableInterrupts();
+    if (++b->arrived < b->n) {
+        Block(&b->q, pid, b, enabled);
+        return P1_SUCCESS;
+    }
+    b->arrived = 0;
+    P2_TRACE(P2_TRACE_SEM_V, 'i', barrier);
+    WakeAll(&b->q, enabled);
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_BarrierFree
+ *
+ * Frees a barrier nobody is waiting at.
+ */
+int
+P2_BarrierFree(int barrier)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc = P1_SUCCESS;
+    if (barrier < 0 || barrier >= P2_MAXBARRIER || !barriers[barrier].inUse) {
+        return P2_INVALID_BARRIER;
+    }
+    int enabled = P2DisableInterrupts();
+    if (barriers[barrier].arrived > 0) {
+        rc = P1_BLOCKED_PROCESSES;
+    } else {
+        barriers[barrier].inUse = FALSE;
+    }
+    P2RestoreInterrupts(enabled);
+    return rc;
+}
+
+/*
+ * P2_CondCreate
+ *
+ * Creates a condition variable.
+ */
+int
+P2_CondCreate(int *cv)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int id;
+    if (cv == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    for (id = 0; id < P2_MAXCOND && conds[id].inUse; id++) {
+    }
+    if (id == P2_MAXCOND) {
+        P2RestoreInterrupts(enabled);
+        return P2_TOO_MANY_CONDS;
+    }
+    conds[id].inUse = TRUE;
+    conds[id].q.head = conds[id].q.tail = -1;
+    P2RestoreInterrupts(enabled);
+    *cv = id;
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_CondWait
+ *
+ * Releases sid and waits on cv, then takes sid again.
+ */
+int
+P2_CondWait(int cv, int sid)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int pid = P1_GetPid();
+    int pids[P1_MAXPROC];
+    P2_SemBuf op = {sid, 1};
+    if (cv < 0 || cv >= P2_MAXCOND || !conds[cv].inUse) {
+        return P2_INVALID_COND;
+    }
+    if (sid < 0 || sid >= P1_MAXSEM || !sems[sid].inUse) {
+        return P1_INVALID_SID;
+    }
+    P2_TRACE(P2_TRACE_SEM_V, 'i', sid);
+    int enabled = P2DisableInterrupts();
+    // the V is done here rather than through P2_SemOp, which mustn't be called by a
+    // process that is already queued; both happen at once, so a signal after the V
+    // finds us on the queue
+    Enqueue(&conds[cv].q, pid, &conds[cv]);
+    sems[sid].value++;
+    int count = GrantWaiters(pids);
+    P2RestoreInterrupts(enabled);
+    Release(&op, 1, pids, count);
+    int start = Now();
+    P2_TRACE(P2_TRACE_SEM_P, 'B', cv);
+    Park(pid);
+    P2_TRACE(P2_TRACE_SEM_P, 'E', cv);
+    P2ProcStatsFor(pid)->semWait += Now() - start;
+    op.delta = -1;
+    return P2_SemOp(&op, 1);
+}
+
+/*
+ * P2_CondSignal
+ *
+ * Wakes the process that has waited longest on cv, if any.
+ */
+int
+P2_CondSignal(int cv)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (cv < 0 || cv >= P2_MAXCOND || !conds[cv].inUse) {
+        return P2_INVALID_COND;
+    }
+    int enabled = P2DisableInterrupts();
+    int pid = Dequeue(&conds[cv].q, NULL);
+    P2RestoreInterrupts(enabled);
+    P2_TRACE(P2_TRACE_SEM_V, 'i', cv);
+    if (pid != -1) {
+        P2ProcUnpark(pid);
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_CondBroadcast
+ *
+ * Wakes every process waiting on cv.
+ */
+int
+P2_CondBroadcast(int cv)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (cv < 0 || cv >= P2_MAXCOND || !conds[cv].inUse) {
+        return P2_INVALID_COND;
+    }
+    P2_TRACE(P2_TRACE_SEM_V, 'i', cv);
+    WakeAll(&conds[cv].q, P2DisableInterrupts());
+    return P1_SUCCESS;
+}
+
+/*
+ * P2_CondFree
+ *
+ * Frees a condition variable nobody is waiting on.
+ */
+int
+P2_CondFree(int cv)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    int rc = P1_SUCCESS;
+    if (cv < 0 || cv >= P2_MAXCOND || !conds[cv].inUse) {
+        return P2_INVALID_COND;
+    }
+    int enabled = P2DisableInterrupts();
+    if (conds[cv].q.head != -1) {
+        rc = P1_BLOCKED_PROCESSES;
+    } else {
+        conds[cv].inUse = FALSE;
+    }
+    P2RestoreInterrupts(enabled);
+    return rc;
+}
+
+static void
+BarrierStub(USLOSS_Sysargs *sysargs)
+{
+    int barrier = -1;
+    int rc;
+    switch ((int) sysargs->arg5) {
+        case P2_BARRIER_CREATE:
+            rc = P2_BarrierCreate((int) sysargs->arg1, &barrier);
+            sysargs->arg1 = (void *) barrier;
+            break;
+        case P2_BARRIER_WAIT:
+            rc = P2_BarrierWait((int) sysargs->arg1);
+            break;
+        case P2_BARRIER_FREE:
+            rc = P2_BarrierFree((int) sysargs->arg1);
+            break;
+        default:
+            rc = P2_INVALID_SYSCALL;
+            break;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+static void
+CondStub(USLOSS_Sysargs *sysargs)
+{
+    int cv = (int) sysargs->arg1;
+    int rc;
+    switch ((int) sysargs->arg5) {
+        case P2_COND_CREATE:
+            rc = P2_CondCreate(&cv);
+            sysargs->arg1 = (void *) cv;
+            break;
+        case P2_COND_WAIT:
+            rc = P2_CondWait(cv, (int) sysargs->arg2);
+            break;
+        case P2_COND_SIGNAL:
+            rc = P2_CondSignal(cv);
+            break;
+        case P2_COND_BROADCAST:
+            rc = P2_CondBroadcast(cv);
+            break;
+        case P2_COND_FREE:
+            rc = P2_CondFree(cv);
+            break;
+        default:
+            rc = P2_INVALID_SYSCALL;
+            break;
+    }
+    sysargs->arg4 = (void *) rc;
+}
+
+/*
+ * P2_SemStatsGet
+ *
+ * Returns a user semaphore's contention statistics.
+ */
+int
+P2_SemStatsGet(int sid, P2_SemStats *stats)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    if (sid < 0 || sid >= P1_MAXSEM || !sems[sid].inUse) {
+        return P1_INVALID_SID;
+    }
+    if (stats == NULL) {
+        return P2_NULL_ADDRESS;
+    }
+    int enabled = P2DisableInterrupts();
+    *stats = sems[sid].stats;
+    P2RestoreInterrupts(enabled);
+    return P1_SUCCESS;
+}
+
+/*
+ * P2SemStatsDump
+ *
+ * Prints the statistics of every user semaphore that has been P'd, including freed
+ * ones, the ones blocked on longest first.
+ */
+void
+P2SemStatsDump(void)
+{
+    if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0){
+        USLOSS_IllegalInstruction();
+    }
+    static int order[P1_MAXSEM];
+    int count = 0;
+    for (int sid = 0; sid < P1_MAXSEM; sid++) {
+        if (sems[sid].stats.p == 0) {
+            continue;
+        }
+        int i = count++;
+        while (i > 0 && sems[order[i-1]].stats.totalWait < sems[sid].stats.totalWait) {
+            order[i] = order[i-1];
+            i--;
+        }
+        order[i] = sid;
+    }
+    if (count == 0) {
+        return;
+    }
+    USLOSS_Console("%-20s %5s %8s %8s %10s %8s %6s %6s\n", "Semaphore", "Sid", "P's", "Blocked",
+                   "Total(us)", "Max(us)", "MaxQ", "Holder");
+    for (int i = 0; i < count; i++) {
+        int sid = order[i];
+        P2_SemStats stats = sems[sid].stats;
+        USLOSS_Console("%-20s %5d %8d %8d %10d %8d %6d %6d\n", sems[sid].name, sid, stats.p,
+                       stats.blocked, stats.totalWait, stats.maxWait, stats.maxQueue,
+                       stats.holder);
+    }
+}
+
+static void
+SemStatsStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg4 = (void *) P2_SemStatsGet((int) sysargs->arg1, (P2_SemStats *) sysargs->arg2);
+}
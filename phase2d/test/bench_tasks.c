@@ -0,0 +1,149 @@
+/*
+ * bench_tasks.c
+ *
+ * Runs the same batch of small tasks twice: once with a process per task, spawned and
+ * reaped in rounds the way test_sleep.c does, and once on a TaskPool. Then runs a
+ * fork-join tree of tasks on the pool, where workers spawn tasks onto their own deques
+ * and idle ones have to steal. Checks the results and reports the time each took.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+#include "libtask.h"
+
+#define TASKS       400
+#define WORK        2000    // loop iterations per task
+#define ROUND       20      // processes alive at once
+#define WORKERS     4
+#define DEPTH       10      // of the fork-join tree
+
+static int passed = FALSE;
+
+static TaskPool pool;
+static int results[TASKS];
+static int leaves = 0;
+
+static int
+Work(int i)
+{
+    int sum = 0;
+    for (int j = 0; j < WORK; j++) {
+        sum += (i ^ j) & 7;
+    }
+    return sum;
+}
+
+int
+Process(void *arg)
+{
+    results[(int) arg] = Work((int) arg);
+    return 0;
+}
+
+void
+Small(TaskWorker *worker, void *arg)
+{
+    results[(int) arg] = Work((int) arg);
+}
+
+/*
+ * Tree
+ *
+ * Spawns two subtrees one level shallower, and counts the leaves.
+ */
+void
+Tree(TaskWorker *worker, void *arg)
+{
+    int depth = (int) arg;
+    if (depth == 0) {
+        Work(depth);
+        __atomic_add_fetch(&leaves, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+    Task_Spawn(worker, Tree, (void *) (depth - 1));
+    Task_Spawn(worker, Tree, (void *) (depth - 1));
+}
+
+static void
+Check(void)
+{
+    for (int i = 0; i < TASKS; i++) {
+        TEST(results[i], Work(i));
+        results[i] = -1;
+    }
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status, start, finish, steals;
+
+    for (int i = 0; i < TASKS; i++) {
+        results[i] = -1;
+    }
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < TASKS; i += ROUND) {
+        for (int j = i; j < i + ROUND; j++) {
+            rc = Sys_Spawn(MakeName("Process", j), Process, (void *) j, USLOSS_MIN_STACK, 4, &pid);
+            TEST(rc, P1_SUCCESS);
+        }
+        for (int j = i; j < i + ROUND; j++) {
+            rc = Sys_Wait(&pid, &status);
+            TEST(rc, P1_SUCCESS);
+        }
+    }
+    Sys_GetTimeOfDay(&finish);
+    USLOSS_Console("%d tasks as processes: %d us.\n", TASKS, finish - start);
+    Check();
+
+    rc = TaskPool_Start(&pool, "Bench", WORKERS, 4);
+    TEST(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < TASKS; i++) {
+        rc = TaskPool_Submit(&pool, Small, (void *) i);
+        TEST(rc, P1_SUCCESS);
+    }
+    TaskPool_Wait(&pool);
+    Sys_GetTimeOfDay(&finish);
+    USLOSS_Console("%d tasks on %d workers: %d us.\n", TASKS, WORKERS, finish - start);
+    Check();
+
+    Sys_GetTimeOfDay(&start);
+    rc = TaskPool_Submit(&pool, Tree, (void *) DEPTH);
+    TEST(rc, P1_SUCCESS);
+    TaskPool_Wait(&pool);
+    Sys_GetTimeOfDay(&finish);
+    TEST(leaves, 1 << DEPTH);
+    steals = TaskPool_Stop(&pool);
+    USLOSS_Console("%d task fork-join tree on %d workers: %d us, %d steals.\n",
+                   (2 << DEPTH) - 1, WORKERS, finish - start, steals);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
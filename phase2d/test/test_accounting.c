@@ -0,0 +1,98 @@
+/*
+ * Tests the per-process accounting counters.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+/*
+ * Worker
+ *
+ * Sleeps, writes three sectors and reads two back, then P's the provided semaphore.
+ */
+int 
+Worker(void *arg) 
+{
+    int sid = (int) arg;
+    int rc;
+    char buffer[3 * USLOSS_DISK_SECTOR_SIZE];
+
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    memset(buffer, 'x', sizeof(buffer));
+    rc = Sys_DiskWrite(buffer, 0, 0, 3, 0);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_DiskRead(buffer, 0, 1, 2, 0);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemP(sid);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    P2_ProcStats stats;
+    int rc, pid, child, status, sid;
+
+    rc = Sys_SemCreate("Accounting", 0, &sid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Worker", Worker, (void *) sid, USLOSS_MIN_STACK, 4, &child);
+    TEST(rc, P1_SUCCESS);
+    // the worker is blocked on the semaphore by the time we wake up
+    rc = Sys_Sleep(3);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemV(sid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(pid, child);
+
+    // the counters stay until the slot is reused
+    rc = Sys_ProcStats(child, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.syscalls[SYS_SLEEP-1], 1);
+    TEST(stats.syscalls[SYS_DISKWRITE-1], 1);
+    TEST(stats.syscalls[SYS_DISKREAD-1], 1);
+    TEST(stats.syscalls[SYS_SEMP-1], 1);
+    TEST(stats.syscalls[SYS_TERMINATE-1], 1);
+    TEST(stats.sleepTime >= 1000000, 1);
+    TEST(stats.sectorsWritten, 3);
+    TEST(stats.sectorsRead, 2);
+    TEST(stats.diskWait > 0, 1);
+    TEST(stats.semWait > 0, 1);
+
+    rc = Sys_ProcStats(P1_MAXPROC, &stats);
+    TEST(rc, P1_INVALID_PID);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
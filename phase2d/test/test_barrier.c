@@ -0,0 +1,224 @@
+/*
+ * Tests the barriers and condition variables: nobody leaves a round of the barrier
+ * until everyone has reached it, and a broadcast wakes every process waiting on a
+ * condition, each of which takes the mutex in turn. Waiting on a condition hands the
+ * mutex to processes already blocked on it.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define WORKERS     4
+#define ROUNDS      3
+#define CONTENDERS  3
+
+static int passed = FALSE;
+
+static int barrier;
+static int arrived[ROUNDS];
+
+static int mutex, cv;
+static int ready = FALSE;
+static int inside = 0;
+static int woken = 0;
+static int entered = 0;
+
+/*
+ * Worker
+ *
+ * Goes through ROUNDS rounds of the barrier, checking that everyone else got to each
+ * round before it left.
+ */
+int
+Worker(void *arg)
+{
+    int rc;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        arrived[round]++;
+        rc = Sys_BarrierWait(barrier);
+        TEST(rc, P1_SUCCESS);
+        TEST(arrived[round], WORKERS);
+    }
+    return 0;
+}
+
+/*
+ * Waiter
+ *
+ * Waits under the mutex until ready is set.
+ */
+int
+Waiter(void *arg)
+{
+    int rc;
+
+    rc = Sys_SemP(mutex);
+    TEST(rc, P1_SUCCESS);
+    while (!ready) {
+        rc = Sys_CondWait(cv, mutex);
+        TEST(rc, P1_SUCCESS);
+    }
+    inside++;
+    TEST(inside, 1);
+    woken++;
+    inside--;
+    rc = Sys_SemV(mutex);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * Sleeper
+ *
+ * Holds the mutex until the Contenders have blocked on it, then waits on the condition,
+ * which lets them in.
+ */
+int
+Sleeper(void *arg)
+{
+    int rc;
+
+    rc = Sys_SemP(mutex);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    while (!ready) {
+        rc = Sys_CondWait(cv, mutex);
+        TEST(rc, P1_SUCCESS);
+    }
+    woken++;
+    rc = Sys_SemV(mutex);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * Contender
+ *
+ * Takes the mutex and gives it back.
+ */
+int
+Contender(void *arg)
+{
+    int rc;
+
+    rc = Sys_SemP(mutex);
+    TEST(rc, P1_SUCCESS);
+    entered++;
+    rc = Sys_SemV(mutex);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status;
+
+    rc = Sys_BarrierCreate(WORKERS, &barrier);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < WORKERS; i++) {
+        rc = Sys_Spawn(MakeName("Worker", i), Worker, NULL, USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i < WORKERS; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = Sys_BarrierFree(barrier);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_BarrierWait(barrier);
+    TEST(rc, P2_INVALID_BARRIER);
+
+    rc = Sys_SemCreate("Mutex", 1, &mutex);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_CondCreate(&cv);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < WORKERS; i++) {
+        rc = Sys_Spawn(MakeName("Waiter", i), Waiter, NULL, USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    // let them all block on the condition
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_CondFree(cv);
+    TEST(rc, P1_BLOCKED_PROCESSES);
+    rc = Sys_SemP(mutex);
+    TEST(rc, P1_SUCCESS);
+    ready = TRUE;
+    rc = Sys_CondBroadcast(cv);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemV(mutex);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < WORKERS; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(woken, WORKERS);
+    rc = Sys_CondSignal(cv);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_CondFree(cv);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_CondWait(cv, mutex);
+    TEST(rc, P2_INVALID_COND);
+
+    // the Contenders block on the mutex while the Sleeper holds it
+    ready = FALSE;
+    woken = 0;
+    rc = Sys_CondCreate(&cv);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Sleeper", Sleeper, NULL, USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < CONTENDERS; i++) {
+        rc = Sys_Spawn(MakeName("Contender", i), Contender, NULL, USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = Sys_Sleep(2);
+    TEST(rc, P1_SUCCESS);
+    TEST(entered, CONTENDERS);
+    TEST(woken, 0);
+    rc = Sys_SemP(mutex);
+    TEST(rc, P1_SUCCESS);
+    ready = TRUE;
+    rc = Sys_CondSignal(cv);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemV(mutex);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < CONTENDERS + 1; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(woken, 1);
+    rc = Sys_CondFree(cv);
+    TEST(rc, P1_SUCCESS);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
@@ -0,0 +1,126 @@
+/*
+ * Tests the user-memory semaphores in libuser2.h: uncontended P and V must not trap,
+ * and a consumer blocked in P must be woken by V. Also times uncontended P/V pairs
+ * against Sys_SemP/Sys_SemV.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define ITEMS   10
+#define ROUNDS  1000
+
+static int passed = FALSE;
+
+static USem full;
+static int consumed = 0;
+
+/*
+ * Consumer
+ *
+ * Runs at a higher priority than P3_Startup, so it blocks in USem_P for every item.
+ */
+int 
+Consumer(void *arg) 
+{
+    int rc;
+
+    for (int i = 0; i < ITEMS; i++) {
+        rc = USem_P(&full);
+        TEST(rc, P1_SUCCESS);
+        consumed++;
+    }
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    USem sem;
+    P2_ProcStats stats;
+    int rc, self, pid, status, sid, start, fast, slow, woken;
+
+    Sys_GetPID(&self);
+
+    // uncontended
+    USem_Init(&sem, 2);
+    rc = USem_P(&sem);
+    TEST(rc, P1_SUCCESS);
+    rc = USem_P(&sem);
+    TEST(rc, P1_SUCCESS);
+    rc = USem_V(&sem);
+    TEST(rc, P1_SUCCESS);
+    rc = USem_V(&sem);
+    TEST(rc, P1_SUCCESS);
+    TEST(sem.value, 2);
+    rc = Sys_ProcStats(self, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.syscalls[SYS_FUTEX-1], 0);
+
+    rc = Sys_FutexWait(&sem.value, 0);
+    TEST(rc, P2_WOULD_BLOCK);
+    rc = Sys_FutexWake(&sem.value, 1, &woken);
+    TEST(rc, P1_SUCCESS);
+    TEST(woken, 0);
+
+    // contended
+    USem_Init(&full, 0);
+    rc = Sys_Spawn("Consumer", Consumer, NULL, USLOSS_MIN_STACK, 2, &pid);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < ITEMS; i++) {
+        TEST(consumed, i);
+        rc = USem_V(&full);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = Sys_Wait(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(consumed, ITEMS);
+
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < ROUNDS; i++) {
+        rc = USem_P(&sem);
+        rc = USem_V(&sem);
+    }
+    Sys_GetTimeOfDay(&fast);
+    fast -= start;
+    rc = Sys_SemCreate("Slow", 1, &sid);
+    TEST(rc, P1_SUCCESS);
+    Sys_GetTimeOfDay(&start);
+    for (int i = 0; i < ROUNDS; i++) {
+        rc = Sys_SemP(sid);
+        rc = Sys_SemV(sid);
+    }
+    Sys_GetTimeOfDay(&slow);
+    slow -= start;
+    USLOSS_Console("%d uncontended P/V pairs: %d us with USem, %d us with Sys_SemP/V.\n",
+                   ROUNDS, fast, slow);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ * Tests the mailboxes: messages arrive in order whether they went through the slots
+ * or straight from a blocked sender, a batched receive takes all there are, and
+ * sends and receives that would block fail or time out when asked to. Timeouts below
+ * -1 are refused.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define SLOTS       4
+#define SLOT_SIZE   16
+#define MESSAGES    8
+
+static int passed = FALSE;
+
+static int mbox;
+
+/*
+ * Producer
+ *
+ * Sends MESSAGES messages, blocking once the mailbox is full.
+ */
+int
+Producer(void *arg)
+{
+    char msg[SLOT_SIZE];
+    int rc;
+
+    for (int i = 0; i < MESSAGES; i++) {
+        snprintf(msg, sizeof(msg), "msg %d", i);
+        rc = Sys_MboxSend(mbox, msg, strlen(msg) + 1, -1);
+        TEST(rc, P1_SUCCESS);
+    }
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    char buf[MESSAGES][SLOT_SIZE];
+    char msg[SLOT_SIZE];
+    int sizes[MESSAGES];
+    int rc, pid, status, got, size;
+    int received = 0;
+
+    rc = Sys_MboxCreate(SLOTS, SLOT_SIZE, &mbox);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_MboxReceive(mbox, buf[0], &size, 0);
+    TEST(rc, P2_WOULD_BLOCK);
+    rc = Sys_MboxReceive(mbox, buf[0], &size, 100000);
+    TEST(rc, P2_TIMEOUT);
+    rc = Sys_MboxReceive(mbox, buf[0], &size, -2);
+    TEST(rc, P2_INVALID_TIMEOUT);
+
+    // the producer runs first, fills the mailbox and blocks on the next message
+    rc = Sys_Spawn("Producer", Producer, NULL, USLOSS_MIN_STACK, 2, &pid);
+    TEST(rc, P1_SUCCESS);
+    while (received < MESSAGES) {
+        rc = Sys_MboxReceiveN(mbox, buf, MESSAGES, sizes, -1, &got);
+        TEST(rc, P1_SUCCESS);
+        TEST(got > 0 && received + got <= MESSAGES, 1);
+        for (int i = 0; i < got; i++) {
+            snprintf(msg, sizeof(msg), "msg %d", received + i);
+            TEST(sizes[i], strlen(msg) + 1);
+            TEST(strcmp(buf[i], msg), 0);
+        }
+        // the slots and the blocked sender's message
+        if (received == 0) {
+            TEST(got, SLOTS + 1);
+        }
+        received += got;
+    }
+    rc = Sys_Wait(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+
+    for (int i = 0; i < SLOTS; i++) {
+        rc = Sys_MboxSend(mbox, "x", 2, 0);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = Sys_MboxSend(mbox, "x", 2, 0);
+    TEST(rc, P2_WOULD_BLOCK);
+    rc = Sys_MboxSend(mbox, "x", 2, 100000);
+    TEST(rc, P2_TIMEOUT);
+    rc = Sys_MboxSend(mbox, "x", 2, -2);
+    TEST(rc, P2_INVALID_TIMEOUT);
+    rc = Sys_MboxSend(mbox, buf, SLOT_SIZE + 1, 0);
+    TEST(rc, P2_INVALID_SIZE);
+
+    rc = Sys_MboxFree(mbox);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_MboxSend(mbox, "x", 2, 0);
+    TEST(rc, P2_INVALID_MBOX);
+    rc = Sys_MboxCreate(0, SLOT_SIZE, &mbox);
+    TEST(rc, P2_INVALID_SIZE);
+    rc = Sys_MboxCreate(P2_MBOX_MAXBYTES / SLOT_SIZE + 1, SLOT_SIZE, &mbox);
+    TEST(rc, P2_INVALID_SIZE);
+    // slots * slotSize overflows an int
+    rc = Sys_MboxCreate(0x10000, 0x10000, &mbox);
+    TEST(rc, P2_INVALID_SIZE);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
@@ -0,0 +1,188 @@
+/*
+ * Tests the mutexes: a free mutex is taken without trapping, and when it is released
+ * the waiter with the highest priority gets it, even if it came last. A waiter lends its
+ * priority to the owner, which then goes ahead of others waiting for a second mutex.
+ * A word that doesn't hold a pid is refused.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+static UMutex mutex;
+static UMutex outer;
+static UMutex corrupt;
+static int order[4];
+static int count = 0;
+
+/*
+ * Locker
+ *
+ * Takes the mutex, records that it got it, and gives it back.
+ */
+int
+Locker(void *arg)
+{
+    int rc, self;
+
+    Sys_GetPID(&self);
+    rc = UMutex_Lock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    TEST(UMutex_Owner(&mutex), self);
+    order[count++] = (int) arg;
+    rc = UMutex_Unlock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * Holder
+ *
+ * Takes outer and then waits for mutex while holding it.
+ */
+int
+Holder(void *arg)
+{
+    int rc, self;
+
+    Sys_GetPID(&self);
+    rc = UMutex_Lock(&outer, self);
+    TEST(rc, P1_SUCCESS);
+    rc = UMutex_Lock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    order[count++] = (int) arg;
+    rc = UMutex_Unlock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    rc = UMutex_Unlock(&outer, self);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * Booster
+ *
+ * Waits for outer, lending its priority to Holder.
+ */
+int
+Booster(void *arg)
+{
+    int rc, self;
+
+    Sys_GetPID(&self);
+    rc = UMutex_Lock(&outer, self);
+    TEST(rc, P1_SUCCESS);
+    rc = UMutex_Unlock(&outer, self);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    P2_ProcStats stats;
+    int rc, self, low, high, holder, pid, status;
+
+    Sys_GetPID(&self);
+    UMutex_Init(&mutex);
+    rc = UMutex_Lock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    TEST(UMutex_Owner(&mutex), self);
+    rc = Sys_ProcStats(self, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.syscalls[SYS_MUTEX-1], 0);
+    rc = Sys_MutexLock(&mutex.word);
+    TEST(rc, P1_INVALID_STATE);
+
+    // words that don't hold a pid + 1 are refused and left alone
+    corrupt.word = P1_MAXPROC + 1;
+    rc = Sys_MutexLock(&corrupt.word);
+    TEST(rc, P1_INVALID_STATE);
+    TEST(corrupt.word, P1_MAXPROC + 1);
+    corrupt.word = -2;
+    rc = Sys_MutexLock(&corrupt.word);
+    TEST(rc, P1_INVALID_STATE);
+    TEST(corrupt.word, -2);
+
+    // the low priority process blocks first
+    rc = Sys_Spawn("Low", Locker, (void *) 5, USLOSS_MIN_STACK, 5, &low);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("High", Locker, (void *) 4, USLOSS_MIN_STACK, 4, &high);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    TEST(count, 0);
+    TEST(mutex.word, (self + 1) | P2_MUTEX_WAITERS);
+
+    rc = UMutex_Unlock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    TEST(UMutex_Owner(&mutex), high);
+    rc = UMutex_Unlock(&mutex, self);
+    TEST(rc, P2_NOT_OWNER);
+    for (int i = 0; i < 2; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(order[0], 4);
+    TEST(order[1], 5);
+    TEST(UMutex_Owner(&mutex), -1);
+
+    // Holder waits behind the higher priority Waiter until Booster waits on Holder
+    UMutex_Init(&outer);
+    rc = UMutex_Lock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Waiter", Locker, (void *) 4, USLOSS_MIN_STACK, 4, &high);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Holder", Holder, (void *) 5, USLOSS_MIN_STACK, 5, &holder);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    TEST(UMutex_Owner(&outer), holder);
+    rc = Sys_Spawn("Booster", Booster, NULL, USLOSS_MIN_STACK, 2, &pid);
+    TEST(rc, P1_SUCCESS);
+    TEST(outer.word, (holder + 1) | P2_MUTEX_WAITERS);
+    rc = UMutex_Unlock(&mutex, self);
+    TEST(rc, P1_SUCCESS);
+    TEST(UMutex_Owner(&mutex), holder);
+    for (int i = 0; i < 3; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(order[2], 5);
+    TEST(order[3], 4);
+    TEST(UMutex_Owner(&mutex), -1);
+    TEST(UMutex_Owner(&outer), -1);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * Tests the reader-writer locks: readers waiting for a writer all get the lock
+ * together when it unlocks, and a reader that comes while a writer is waiting goes
+ * after the writer.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define READERS     3
+
+static int passed = FALSE;
+
+static int rw;
+static char order[READERS + 3];
+static int count = 0;
+static int inside = 0;
+static int maxInside = 0;
+
+/*
+ * Reader
+ *
+ * Holds the lock for reading for a second, recording arg as it gets it.
+ */
+int
+Reader(void *arg)
+{
+    int rc;
+
+    rc = Sys_RwRead(rw);
+    TEST(rc, P1_SUCCESS);
+    order[count++] = (char) (int) arg;
+    inside++;
+    if (inside > maxInside) {
+        maxInside = inside;
+    }
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    inside--;
+    rc = Sys_RwUnlock(rw);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int
+Writer(void *arg)
+{
+    int rc;
+
+    rc = Sys_RwWrite(rw);
+    TEST(rc, P1_SUCCESS);
+    order[count++] = 'W';
+    TEST(inside, 0);
+    rc = Sys_RwUnlock(rw);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status;
+
+    rc = Sys_RwCreate(&rw);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_RwWrite(rw);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_RwRead(rw);
+    TEST(rc, P1_INVALID_STATE);
+
+    // the readers, then a writer, block behind us
+    for (int i = 0; i < READERS; i++) {
+        rc = Sys_Spawn(MakeName("Reader", i), Reader, (void *) 'R', USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = Sys_Spawn("Writer", Writer, NULL, USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    TEST(count, 0);
+
+    // the readers all get it; the late reader waits for the writer
+    rc = Sys_RwUnlock(rw);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Late", Reader, (void *) 'L', USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < READERS + 2; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    order[count] = '\0';
+    TEST(strcmp(order, "RRRWL"), 0);
+    TEST(maxInside, READERS);
+
+    rc = Sys_RwUnlock(rw);
+    TEST(rc, P2_NOT_OWNER);
+    rc = Sys_RwFree(rw);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_RwRead(rw);
+    TEST(rc, P2_INVALID_RWLOCK);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
@@ -0,0 +1,119 @@
+/*
+ * Tests Sys_SemOp: a process that needs two resources doesn't hold one while it waits
+ * for the other, and gets both as soon as they are both free.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+static int a, b;
+static int gotBoth = FALSE;
+
+/*
+ * Both
+ *
+ * Takes a and b together, then gives them back.
+ */
+int 
+Both(void *arg) 
+{
+    P2_SemBuf ops[2] = {{a, -1}, {b, -1}};
+    int rc;
+
+    rc = Sys_SemOp(ops, 2);
+    TEST(rc, P1_SUCCESS);
+    gotBoth = TRUE;
+    ops[0].delta = 1;
+    ops[1].delta = 1;
+    rc = Sys_SemOp(ops, 2);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    P2_SemBuf ops[P2_SEMOP_MAX + 1];
+    int rc, pid, status;
+
+    rc = Sys_SemCreate("A", 1, &a);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemCreate("B", 1, &b);
+    TEST(rc, P1_SUCCESS);
+
+    // hold a, so Both blocks without taking b
+    rc = Sys_SemP(a);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("Both", Both, NULL, USLOSS_MIN_STACK, 2, &pid);
+    TEST(rc, P1_SUCCESS);
+    TEST(gotBoth, FALSE);
+    rc = Sys_SemP(b);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemV(b);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemFree(a);
+    TEST(rc, P1_BLOCKED_PROCESSES);
+
+    // freeing a lets it take both, run, and give them back
+    rc = Sys_SemV(a);
+    TEST(rc, P1_SUCCESS);
+    TEST(gotBoth, TRUE);
+    rc = Sys_Wait(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+
+    // several units at once, all or nothing
+    ops[0].sid = a;
+    ops[0].delta = 1;
+    ops[1].sid = b;
+    ops[1].delta = 2;
+    rc = Sys_SemOp(ops, 2);
+    TEST(rc, P1_SUCCESS);
+    ops[0].delta = -2;
+    ops[1].delta = -3;
+    rc = Sys_SemOp(ops, 2);
+    TEST(rc, P1_SUCCESS);
+
+    ops[0].sid = -1;
+    rc = Sys_SemOp(ops, 1);
+    TEST(rc, P1_INVALID_SID);
+    rc = Sys_SemOp(ops, P2_SEMOP_MAX + 1);
+    TEST(rc, P1_INVALID_STATE);
+    rc = Sys_SemOp(NULL, 1);
+    TEST(rc, P2_NULL_ADDRESS);
+
+    rc = Sys_SemFree(a);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemP(a);
+    TEST(rc, P1_INVALID_SID);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Tests Sys_SemOpen: processes that only share a name get the same semaphore, names
+ * of semaphores made by Sys_SemCreate are found too, and a freed name is forgotten.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+#define SEMS    100
+
+static int passed = FALSE;
+
+/*
+ * Opener
+ *
+ * Opens "Shared" and V's it.
+ */
+int
+Opener(void *arg)
+{
+    int rc, sid, created;
+
+    rc = Sys_SemOpen("Shared", 0, &sid, &created);
+    TEST(rc, P1_SUCCESS);
+    TEST(created, FALSE);
+    TEST(sid, (int) arg);
+    rc = Sys_SemV(sid);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int sids[SEMS];
+    int rc, pid, status, sid, other, created;
+
+    rc = Sys_SemOpen("Shared", 0, &sid, &created);
+    TEST(rc, P1_SUCCESS);
+    TEST(created, TRUE);
+    rc = Sys_Spawn("Opener", Opener, (void *) sid, USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    // only the opener's V lets this through
+    rc = Sys_SemP(sid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    TEST(rc, P1_SUCCESS);
+
+    for (int i = 0; i < SEMS; i++) {
+        rc = Sys_SemCreate(MakeName("Sem", i), i, &sids[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i < SEMS; i++) {
+        rc = Sys_SemOpen(MakeName("Sem", i), 0, &other, &created);
+        TEST(rc, P1_SUCCESS);
+        TEST(created, FALSE);
+        TEST(other, sids[i]);
+    }
+    rc = Sys_SemCreate("Shared", 0, &other);
+    TEST(rc, P1_DUPLICATE_NAME);
+
+    rc = Sys_SemFree(sid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemOpen("Shared", 1, &sid, &created);
+    TEST(rc, P1_SUCCESS);
+    TEST(created, TRUE);
+    rc = Sys_SemP(sid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemOpen(NULL, 0, &sid, &created);
+    TEST(rc, P1_NAME_IS_NULL);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
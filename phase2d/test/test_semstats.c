@@ -0,0 +1,106 @@
+/*
+ * Tests Sys_SemStats: two processes block on a semaphore held by P3_Startup, which
+ * shows up as the holder.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+static int sid;
+
+/*
+ * Worker
+ *
+ * Takes the semaphore and gives it back.
+ */
+int
+Worker(void *arg)
+{
+    int rc;
+
+    rc = Sys_SemP(sid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemV(sid);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    P2_SemStats stats;
+    int rc, self, pid, status;
+
+    Sys_GetPID(&self);
+    rc = Sys_SemCreate("Lock", 1, &sid);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemStats(sid, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.p, 0);
+    TEST(stats.holder, -1);
+    TEST(stats.contenders[0], -1);
+
+    rc = Sys_SemP(sid);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < 2; i++) {
+        rc = Sys_Spawn(MakeName("Worker", i), Worker, NULL, USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    // both block behind us
+    rc = Sys_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_SemV(sid);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < 2; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+
+    rc = Sys_SemStats(sid, &stats);
+    TEST(rc, P1_SUCCESS);
+    TEST(stats.p, 3);
+    TEST(stats.blocked, 2);
+    TEST(stats.maxQueue, 2);
+    TEST(stats.holder, self);
+    TEST(stats.contenders[0], self);
+    TEST(stats.blames[0], 2);
+    TEST(stats.contenders[1], -1);
+    TEST(stats.maxWait > 0, 1);
+    TEST(stats.totalWait >= stats.maxWait, 1);
+
+    rc = Sys_SemStats(-1, &stats);
+    TEST(rc, P1_INVALID_SID);
+    rc = Sys_SemStats(sid, NULL);
+    TEST(rc, P2_NULL_ADDRESS);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}
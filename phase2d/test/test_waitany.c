@@ -0,0 +1,139 @@
+/*
+ * Tests Sys_WaitAny: one process waits on a semaphore, a child and a disk request at
+ * once, and is told which of them happened.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+#include "libuser2.h"
+
+static int passed = FALSE;
+
+static int sem;
+
+/*
+ * Poster
+ *
+ * V's the semaphore, then quits once it is run again.
+ */
+int
+Poster(void *arg)
+{
+    int rc;
+
+    rc = Sys_SemV(sem);
+    TEST(rc, P1_SUCCESS);
+    return 7;
+}
+
+int P3_Startup(void *arg) {
+    P2_WaitObj objs[3];
+    P2_DiskIO io;
+    char out[USLOSS_DISK_SECTOR_SIZE];
+    char in[USLOSS_DISK_SECTOR_SIZE];
+    int rc, pid, which, ticket, result;
+
+    rc = Sys_SemCreate("Sem", 0, &sem);
+    TEST(rc, P1_SUCCESS);
+    objs[0].type = P2_WAIT_SEM;
+    objs[0].id = sem;
+    rc = Sys_WaitAny(objs, 1, 0, &which);
+    TEST(rc, P2_WOULD_BLOCK);
+    rc = Sys_WaitAny(objs, 1, 100000, &which);
+    TEST(rc, P2_TIMEOUT);
+    rc = Sys_WaitAny(objs, 1, -2, &which);
+    TEST(rc, P2_INVALID_TIMEOUT);
+
+    // the child V's before it quits, so the semaphore comes first
+    rc = Sys_Spawn("Poster", Poster, NULL, USLOSS_MIN_STACK, 4, &pid);
+    TEST(rc, P1_SUCCESS);
+    objs[0].type = P2_WAIT_CHILD;
+    objs[0].id = -1;
+    objs[1].type = P2_WAIT_SEM;
+    objs[1].id = sem;
+    rc = Sys_WaitAny(objs, 2, -1, &which);
+    TEST(rc, P1_SUCCESS);
+    TEST(which, 1);
+    rc = Sys_WaitAny(objs, 2, -1, &which);
+    TEST(rc, P1_SUCCESS);
+    TEST(which, 0);
+    TEST(objs[0].pid, pid);
+    TEST(objs[0].result, 7);
+
+    // a write, and nothing else that can happen
+    memset(out, 'x', sizeof(out));
+    io.write = TRUE;
+    io.unit = 0;
+    io.track = 0;
+    io.first = 1;
+    io.sectors = 1;
+    io.buffer = out;
+    rc = Sys_DiskSubmit(&io, &ticket);
+    TEST(rc, P1_SUCCESS);
+    objs[0].type = P2_WAIT_SEM;
+    objs[0].id = sem;
+    objs[1].type = P2_WAIT_DISK;
+    objs[1].id = ticket;
+    rc = Sys_WaitAny(objs, 2, -1, &which);
+    TEST(rc, P1_SUCCESS);
+    TEST(which, 1);
+    TEST(objs[1].result, P1_SUCCESS);
+    rc = Sys_DiskPoll(ticket, &result);
+    TEST(rc, P2_INVALID_TICKET);
+    rc = Sys_DiskRead(in, 0, 1, 1, 0);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(in, out, sizeof(in)), 0);
+
+    // polling a request by hand
+    io.write = FALSE;
+    io.buffer = in;
+    rc = Sys_DiskSubmit(&io, &ticket);
+    TEST(rc, P1_SUCCESS);
+    do {
+        rc = Sys_DiskPoll(ticket, &result);
+    } while (rc == P2_WOULD_BLOCK);
+    TEST(rc, P1_SUCCESS);
+    TEST(result, P1_SUCCESS);
+
+    // no children left to wait for
+    objs[0].type = P2_WAIT_CHILD;
+    objs[0].id = -1;
+    rc = Sys_WaitAny(objs, 1, -1, &which);
+    TEST(rc, P1_NO_CHILDREN);
+    TEST(which, 0);
+    objs[0].type = 42;
+    rc = Sys_WaitAny(objs, 1, -1, &which);
+    TEST(rc, P2_INVALID_FLAGS);
+    rc = Sys_WaitAny(objs, P2_WAITANY_MAX + 1, -1, &which);
+    TEST(rc, P1_INVALID_STATE);
+    PASSED();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    DeleteAllDisks();
+    rc = Disk_Create(NULL, 0, 1);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    } else {
+        USLOSS_Console("TEST FAILED!!\n");
+    }
+}